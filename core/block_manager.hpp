@@ -130,6 +130,12 @@ namespace livegraph
             }
         }
 
+        // Blocks are carved from the region back to back, freed ones included, in [get_first_block(),
+        // get_end_block()); the null holder comes first. Only stable without concurrent allocations.
+        uintptr_t get_first_block() const { return null_holder + (1ul << LARGE_BLOCK_THRESHOLD); }
+
+        uintptr_t get_end_block() const { return used_size.load(); }
+
         /**
          * 将给定的块指针转换为指定类型的指针。
          *
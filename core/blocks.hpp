@@ -15,8 +15,11 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <string_view>
+#include <vector>
 
 #include "bloom_filter.hpp"
 #include "types.hpp"
@@ -33,7 +36,8 @@ namespace livegraph
             VERTEX,
             EDGE,
             EDGE_LABEL,
-            SPECIAL
+            SPECIAL,
+            KEY
         };
 
         order_t get_order() const { return order; }
@@ -138,6 +142,40 @@ namespace livegraph
         char data[0];
     };
 
+    // An external key of a vertex, referenced from Graph::key_index and Graph::vertex_key_ptrs. It is never
+    // overwritten: an aborted insertion leaves it with ROLLBACK_TOMBSTONE as creation time until compaction frees it.
+    class KeyBlockHeader : public BlockHeader
+    {
+    public:
+        vertex_t get_vertex_id() const { return ((vertex_t)vid_high << 32) + (vertex_t)vid_low; }
+
+        timestamp_t *get_creation_time_pointer() { return &creation_time; }
+
+        uint32_t get_hash() const { return hash; }
+
+        std::string_view get_key() const { return std::string_view(data, length); }
+
+        void fill(order_t order, vertex_t vid, timestamp_t creation_time, uint64_t hash, std::string_view key)
+        {
+            BlockHeader::fill(order, Type::KEY);
+            assert(vid <= ((vertex_t)UINT16_MAX << 32) + UINT32_MAX);
+            vid_high = (vid >> 32) & UINT16_MAX;
+            vid_low = vid & UINT32_MAX;
+            this->creation_time = creation_time;
+            this->hash = hash;
+            length = key.size();
+            std::copy(key.begin(), key.end(), data);
+        }
+
+    private:
+        uint16_t vid_high;
+        uint32_t vid_low;
+        timestamp_t creation_time;
+        uint32_t hash; // low bits of KeyIndex::hash, compared before the key
+        uint32_t length;
+        char data[0];
+    };
+
     class EdgeLabelEntry
     {
     public:
@@ -368,6 +406,40 @@ namespace livegraph
             return std::make_pair(cur_val.data.num_entries, cur_val.data.data_length);
         }
 
+        // Length of the longest prefix of the first num_entries entries in ascending dst order, oldest first.
+        size_t get_num_sorted_entries(size_t num_entries) const
+        {
+            auto entries = get_entries();
+            for (size_t i = 1; i < num_entries; i++)
+            {
+                if ((entries - i - 1)->get_dst() < (entries - i)->get_dst())
+                    return i;
+            }
+            return num_entries;
+        }
+
+        // Appends the first num_entries entries of src for which keep(entry) holds, in ascending dst order. Entries
+        // with the same dst keep their relative order, so that the newest version stays the last one.
+        template <typename F> void append_sorted(EdgeBlockHeader *src, size_t num_entries, F &&keep)
+        {
+            std::vector<std::pair<EdgeEntry *, const char *>> selected;
+            selected.reserve(num_entries);
+            auto entries = src->get_entries();
+            const char *data = src->get_data();
+            for (size_t i = 0; i < num_entries; i++)
+            {
+                entries--;
+                if (keep(*entries))
+                    selected.emplace_back(entries, data);
+                data += entries->get_length();
+            }
+            std::stable_sort(selected.begin(), selected.end(),
+                             [](const auto &a, const auto &b) { return a.first->get_dst() < b.first->get_dst(); });
+            auto filter = get_bloom_filter();
+            for (auto [entry, entry_data] : selected)
+                append(*entry, entry_data, filter);
+        }
+
         void
         fill(order_t order, vertex_t vid, timestamp_t creation_time, uintptr_t prev_pointer, timestamp_t committed_time)
         {
@@ -0,0 +1,144 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "types.hpp"
+
+namespace livegraph
+{
+    enum class ContentionEvent : uint8_t
+    {
+        LockWait,    // a lock was found held and the transaction had to wait
+        WaitDie,     // rolled back for requesting a lock held by an older transaction
+        LockTimeout, // rolled back after waiting too long for a lock
+        WriteWrite,  // rolled back, a newer version was committed after the read epoch
+        ReadWrite,   // rolled back by serializable read-set validation
+        NUM_EVENTS
+    };
+
+    struct ContentionRecord
+    {
+        vertex_t vertex_id;
+        label_t label; // ContentionProfiler::NO_LABEL for vertex-level events
+        size_t count;  // estimated number of sampled events, over-estimated by at most error
+        size_t error;
+        size_t events[(size_t)ContentionEvent::NUM_EVENTS]; // sampled events since the key entered the sketch
+    };
+
+    /**
+     * 冲突热点统计：对锁等待和回滚按 (vertex, label) 采样，
+     * 用 space-saving 草图保留计数最大的 capacity 个键。
+     * 只在锁等待和回滚这类慢路径上调用，关闭时只有一次原子读。
+     */
+    class ContentionProfiler
+    {
+    public:
+        ContentionProfiler(size_t _capacity = DEFAULT_CAPACITY)
+            : capacity(_capacity), sample_period(0), mutex(), index(), records()
+        {
+        }
+
+        // sample_period = n records one in n events per thread; 0 disables the profiler.
+        void enable(size_t period = 1) { sample_period.store(period, std::memory_order_relaxed); }
+
+        void disable() { sample_period.store(0, std::memory_order_relaxed); }
+
+        bool enabled() const { return sample_period.load(std::memory_order_relaxed) != 0; }
+
+        void record(vertex_t vertex_id, label_t label, ContentionEvent event)
+        {
+            auto period = sample_period.load(std::memory_order_relaxed);
+            if (!period)
+                return;
+            thread_local size_t tick = 0;
+            if (++tick % period)
+                return;
+
+            auto key = std::make_pair(vertex_id, label);
+            std::lock_guard<std::mutex> lock(mutex);
+            auto iter = index.find(key);
+            size_t pos;
+            if (iter != index.end())
+            {
+                pos = iter->second;
+            }
+            else if (records.size() < capacity)
+            {
+                pos = records.size();
+                records.push_back(ContentionRecord{vertex_id, label, 0, 0, {}});
+                index.emplace(key, pos);
+            }
+            else
+            {
+                // Space-saving: the new key takes over the minimum entry and inherits its count as error.
+                pos = std::min_element(records.begin(), records.end(),
+                                       [](const auto &a, const auto &b) { return a.count < b.count; }) -
+                      records.begin();
+                auto &victim = records[pos];
+                index.erase(std::make_pair(victim.vertex_id, victim.label));
+                victim = ContentionRecord{vertex_id, label, victim.count, victim.count, {}};
+                index.emplace(key, pos);
+            }
+            records[pos].count++;
+            records[pos].events[(size_t)event]++;
+        }
+
+        std::vector<ContentionRecord> top(size_t k) const
+        {
+            std::vector<ContentionRecord> result;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                result = records;
+            }
+            k = std::min(k, result.size());
+            std::partial_sort(result.begin(), result.begin() + k, result.end(),
+                              [](const auto &a, const auto &b) { return a.count > b.count; });
+            result.resize(k);
+            return result;
+        }
+
+        void reset()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            index.clear();
+            records.clear();
+        }
+
+        constexpr static label_t NO_LABEL = UINT16_MAX;
+        constexpr static size_t DEFAULT_CAPACITY = 256;
+
+    private:
+        struct KeyHash
+        {
+            size_t operator()(const std::pair<vertex_t, label_t> &key) const
+            {
+                return (key.first * 0x9E3779B97F4A7C15ull) ^ key.second;
+            }
+        };
+
+        const size_t capacity;
+        std::atomic<size_t> sample_period;
+        mutable std::mutex mutex;
+        std::unordered_map<std::pair<vertex_t, label_t>, size_t, KeyHash> index;
+        std::vector<ContentionRecord> records;
+    };
+} // namespace livegraph
@@ -0,0 +1,242 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "types.hpp"
+
+namespace livegraph
+{
+    /**
+     * 只读的 CSR 快照，由 Transaction::materialize_csr 生成。
+     * 所有数组连续存放在一段内存（匿名映射或文件映射）中，文件格式与内存布局一致，
+     * 可以直接用 CSR::open 或其他程序 mmap 读取。
+     *
+     * 布局：Header | offsets[num_vertices + 1] | dsts[num_edges] | labels[num_edges]（多于一个标签时）|
+     *      property_offsets[num_edges + 1]（属性变长时）| property_data
+     * 各数组按 8 字节对齐。
+     */
+    class CSR
+    {
+    public:
+        struct Header
+        {
+            uint64_t magic;
+            uint64_t num_vertices;
+            uint64_t num_edges;
+            uint64_t num_labels;
+            uint64_t property_width; // NO_PROPERTY, VARIABLE_WIDTH or the common length of all edge properties
+            uint64_t property_data_size;
+            int64_t read_epoch_id;
+            uint64_t offsets_offset;
+            uint64_t dsts_offset;
+            uint64_t labels_offset;
+            uint64_t property_offsets_offset;
+            uint64_t property_data_offset;
+            uint64_t total_size;
+        };
+
+        constexpr static uint64_t MAGIC = 0x31525343484c4752ull; // "RGLHCSR1"
+        constexpr static uint64_t NO_PROPERTY = 0;
+        constexpr static uint64_t VARIABLE_WIDTH = UINT64_MAX;
+        constexpr static uint64_t NO_ARRAY = 0;
+
+        CSR() : data(nullptr), size(0), fd(EMPTY_FD) {}
+
+        CSR(const CSR &) = delete;
+
+        CSR(CSR &&csr) : data(csr.data), size(csr.size), fd(csr.fd)
+        {
+            csr.data = nullptr;
+            csr.size = 0;
+            csr.fd = EMPTY_FD;
+        }
+
+        CSR &operator=(CSR &&csr)
+        {
+            std::swap(data, csr.data);
+            std::swap(size, csr.size);
+            std::swap(fd, csr.fd);
+            return *this;
+        }
+
+        ~CSR() { release(); }
+
+        // Lays out the arrays for the given sizes in anonymous memory, or in a new file at path.
+        static CSR create(const std::string &path,
+                          uint64_t num_vertices,
+                          uint64_t num_edges,
+                          uint64_t num_labels,
+                          uint64_t property_width,
+                          uint64_t property_data_size,
+                          timestamp_t read_epoch_id)
+        {
+            Header header{};
+            header.magic = MAGIC;
+            header.num_vertices = num_vertices;
+            header.num_edges = num_edges;
+            header.num_labels = num_labels;
+            header.property_width = property_width;
+            header.property_data_size = property_data_size;
+            header.read_epoch_id = read_epoch_id;
+
+            uint64_t cursor = align(sizeof(Header));
+            auto place = [&](uint64_t bytes) {
+                auto offset = cursor;
+                cursor = align(cursor + bytes);
+                return offset;
+            };
+            header.offsets_offset = place((num_vertices + 1) * sizeof(uint64_t));
+            header.dsts_offset = place(num_edges * sizeof(vertex_t));
+            header.labels_offset = num_labels > 1 ? place(num_edges * sizeof(label_t)) : NO_ARRAY;
+            header.property_offsets_offset =
+                property_width == VARIABLE_WIDTH ? place((num_edges + 1) * sizeof(uint64_t)) : NO_ARRAY;
+            header.property_data_offset = property_width != NO_PROPERTY ? place(property_data_size) : NO_ARRAY;
+            header.total_size = cursor;
+
+            CSR csr;
+            csr.size = header.total_size;
+            if (path.empty())
+            {
+                csr.data = mmap(nullptr, csr.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                                -1, 0);
+            }
+            else
+            {
+                csr.fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0640);
+                if (csr.fd == EMPTY_FD)
+                    throw std::runtime_error("open csr file error.");
+                if (ftruncate(csr.fd, csr.size) != 0)
+                    throw std::runtime_error("ftruncate csr file error.");
+                csr.data = mmap(nullptr, csr.size, PROT_READ | PROT_WRITE, MAP_SHARED, csr.fd, 0);
+            }
+            if (csr.data == MAP_FAILED)
+            {
+                csr.data = nullptr;
+                throw std::runtime_error("mmap csr error.");
+            }
+            std::memcpy(csr.data, &header, sizeof(header));
+            return csr;
+        }
+
+        // Maps a file written by materialize_csr read-only.
+        static CSR open(const std::string &path)
+        {
+            CSR csr;
+            csr.fd = ::open(path.c_str(), O_RDONLY);
+            if (csr.fd == EMPTY_FD)
+                throw std::runtime_error("open csr file error.");
+            struct stat st;
+            if (fstat(csr.fd, &st) != 0 || (size_t)st.st_size < sizeof(Header))
+                throw std::runtime_error("invalid csr file.");
+            csr.size = st.st_size;
+            csr.data = mmap(nullptr, csr.size, PROT_READ, MAP_SHARED, csr.fd, 0);
+            if (csr.data == MAP_FAILED)
+            {
+                csr.data = nullptr;
+                throw std::runtime_error("mmap csr error.");
+            }
+            if (csr.header().magic != MAGIC || csr.header().total_size != csr.size)
+                throw std::runtime_error("invalid csr file.");
+            return csr;
+        }
+
+        // Flushes a file-backed CSR to disk.
+        void sync()
+        {
+            if (fd != EMPTY_FD && msync(data, size, MS_SYNC) != 0)
+                throw std::runtime_error("msync csr file error.");
+        }
+
+        bool valid() const { return data != nullptr; }
+
+        const Header &header() const { return *static_cast<const Header *>(data); }
+
+        uint64_t get_num_vertices() const { return header().num_vertices; }
+        uint64_t get_num_edges() const { return header().num_edges; }
+        timestamp_t get_read_epoch_id() const { return header().read_epoch_id; }
+
+        // Edges of v are [offsets[v], offsets[v + 1]).
+        const uint64_t *get_offsets() const { return array<uint64_t>(header().offsets_offset); }
+        const vertex_t *get_dsts() const { return array<vertex_t>(header().dsts_offset); }
+        // Only stored when more than one label was materialized.
+        const label_t *get_labels() const { return array<label_t>(header().labels_offset); }
+
+        uint64_t get_degree(vertex_t v) const { return get_offsets()[v + 1] - get_offsets()[v]; }
+
+        bool has_properties() const { return header().property_width != NO_PROPERTY; }
+
+        std::string_view get_property(uint64_t edge) const
+        {
+            auto width = header().property_width;
+            auto base = array<char>(header().property_data_offset);
+            if (width == NO_PROPERTY)
+                return std::string_view();
+            if (width != VARIABLE_WIDTH)
+                return std::string_view(base + edge * width, width);
+            auto offsets = array<uint64_t>(header().property_offsets_offset);
+            return std::string_view(base + offsets[edge], offsets[edge + 1] - offsets[edge]);
+        }
+
+        // A typed column, only when every edge property is exactly sizeof(T) bytes; nullptr otherwise.
+        template <typename T> const T *get_property_column() const
+        {
+            if (header().property_width != sizeof(T))
+                return nullptr;
+            return array<T>(header().property_data_offset);
+        }
+
+        // Writable views, used while building.
+        template <typename T> T *mutable_array(uint64_t offset) { return const_cast<T *>(array<T>(offset)); }
+        Header &mutable_header() { return *static_cast<Header *>(data); }
+
+    private:
+        void *data;
+        size_t size;
+        int fd;
+
+        constexpr static int EMPTY_FD = -1;
+
+        static uint64_t align(uint64_t offset) { return (offset + 7) & ~7ull; }
+
+        template <typename T> const T *array(uint64_t offset) const
+        {
+            if (offset == NO_ARRAY)
+                return nullptr;
+            return reinterpret_cast<const T *>(static_cast<const char *>(data) + offset);
+        }
+
+        void release()
+        {
+            if (data)
+                munmap(data, size);
+            if (fd != EMPTY_FD)
+                close(fd);
+            data = nullptr;
+            fd = EMPTY_FD;
+        }
+    };
+} // namespace livegraph
@@ -0,0 +1,84 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <tbb/concurrent_map.h>
+#include <tbb/spin_mutex.h>
+
+#include "types.hpp"
+
+namespace livegraph
+{
+    struct EdgeChange
+    {
+        vertex_t src;
+        vertex_t dst;
+        bool inserted;        // otherwise deleted
+        timestamp_t epoch;    // creation or deletion time of the edge
+        std::string_view data;
+    };
+
+    /**
+     * 按提交时间戳记录修改过边的 (src, label)，供全图的增量查询（Transaction::get_edge_changes）只访问变化过的邻接表。
+     * 在事务提交时写入；同一时间戳可能有多个事务（组提交）以及批量导入，因此每个时间戳的列表带锁。
+     * 只覆盖 start_epoch 之后的提交。
+     */
+    class EdgeChangeLog
+    {
+    public:
+        explicit EdgeChangeLog(timestamp_t _start_epoch) : start_epoch(_start_epoch), epochs() {}
+
+        EdgeChangeLog(const EdgeChangeLog &) = delete;
+
+        timestamp_t get_start_epoch() const { return start_epoch; }
+
+        void append(timestamp_t epoch, const std::vector<std::pair<vertex_t, label_t>> &edge_lists)
+        {
+            auto iter = epochs.find(epoch);
+            if (iter == epochs.end())
+                iter = epochs.emplace(epoch, std::make_unique<Epoch>()).first;
+            tbb::spin_mutex::scoped_lock lock(iter->second->mutex);
+            auto &lists = iter->second->edge_lists;
+            lists.insert(lists.end(), edge_lists.begin(), edge_lists.end());
+        }
+
+        // Calls f(src, label) for the edge lists changed by the commits in (e1, e2], possibly more than once.
+        template <typename F> void scan(timestamp_t e1, timestamp_t e2, F &&f)
+        {
+            for (auto iter = epochs.upper_bound(e1); iter != epochs.end() && iter->first <= e2; ++iter)
+            {
+                tbb::spin_mutex::scoped_lock lock(iter->second->mutex);
+                for (auto [src, label] : iter->second->edge_lists)
+                    f(src, label);
+            }
+        }
+
+    private:
+        struct Epoch
+        {
+            tbb::spin_mutex mutex;
+            std::vector<std::pair<vertex_t, label_t>> edge_lists;
+        };
+
+        const timestamp_t start_epoch;
+        tbb::concurrent_map<timestamp_t, std::unique_ptr<Epoch>> epochs;
+    };
+} // namespace livegraph
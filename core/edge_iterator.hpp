@@ -134,6 +134,16 @@ namespace livegraph
                 return (entries_cursor - 1)->get_dst();
         }
 
+        timestamp_t version() const
+        {
+            if (!valid())
+                return -1;
+            if (!reverse)
+                return entries_cursor->get_version();
+            else
+                return (entries_cursor - 1)->get_version();
+        }
+
         std::string_view edge_data() const
         {
             if (!valid())
@@ -0,0 +1,172 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace livegraph
+{
+    struct FlatHash
+    {
+        template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>> uint64_t operator()(T key) const
+        {
+            return (uint64_t)key;
+        }
+
+        template <typename T> uint64_t operator()(T *key) const { return (uint64_t)(uintptr_t)key; }
+
+        template <typename T1, typename T2> uint64_t operator()(const std::pair<T1, T2> &key) const
+        {
+            return (*this)(key.first) * 0xC2B2AE3D27D4EB4Full ^ (*this)(key.second);
+        }
+    };
+
+    /**
+     * 用于事务内部缓存的开放寻址哈希表（线性探测）。
+     * 元素按插入顺序连续存放在 entries 中，slots 只保存 (generation, 下标)，
+     * 因此遍历只访问已插入的元素，clear() 只需递增 generation，不需要清空整张表。
+     * 不支持删除；插入可能使迭代器失效。
+     */
+    template <typename K, typename V, typename Hash = FlatHash> class FlatHashMap
+    {
+    public:
+        using value_type = std::pair<K, V>;
+        using iterator = value_type *;
+        using const_iterator = const value_type *;
+
+        FlatHashMap() : entries(), slots(), generation(1), shift(64) {}
+
+        size_t size() const { return entries.size(); }
+
+        bool empty() const { return entries.empty(); }
+
+        size_t capacity() const { return slots.size(); }
+
+        iterator begin() { return entries.data(); }
+        iterator end() { return entries.data() + entries.size(); }
+        const_iterator begin() const { return entries.data(); }
+        const_iterator end() const { return entries.data() + entries.size(); }
+
+        iterator find(const K &key)
+        {
+            auto index = lookup(key);
+            return index == NOT_FOUND ? end() : begin() + index;
+        }
+
+        const_iterator find(const K &key) const
+        {
+            auto index = lookup(key);
+            return index == NOT_FOUND ? end() : begin() + index;
+        }
+
+        std::pair<iterator, bool> emplace(const K &key, const V &value)
+        {
+            if ((entries.size() + 1) * MAX_LOAD_DENOMINATOR > slots.size() * MAX_LOAD_NUMERATOR)
+                grow();
+            for (size_t pos = home(key);; pos = (pos + 1) & (slots.size() - 1))
+            {
+                auto slot = slots[pos];
+                if ((slot >> 32) != generation)
+                {
+                    slots[pos] = make_slot(entries.size());
+                    entries.emplace_back(key, value);
+                    return {end() - 1, true};
+                }
+                auto &entry = entries[(uint32_t)slot];
+                if (entry.first == key)
+                    return {&entry, false};
+            }
+        }
+
+        // The hint is ignored; kept for drop-in compatibility with the std containers.
+        iterator emplace_hint(const_iterator, const K &key, const V &value) { return emplace(key, value).first; }
+
+        V &operator[](const K &key) { return emplace(key, V()).first->second; }
+
+        void clear()
+        {
+            entries.clear();
+            if (++generation == 0)
+            {
+                for (auto &slot : slots)
+                    slot = 0;
+                generation = 1;
+            }
+        }
+
+        void swap(FlatHashMap &other)
+        {
+            entries.swap(other.entries);
+            slots.swap(other.slots);
+            std::swap(generation, other.generation);
+            std::swap(shift, other.shift);
+        }
+
+        // Bytes held by the table, for space accounting.
+        size_t memory_usage() const
+        {
+            return sizeof(*this) + entries.capacity() * sizeof(value_type) + slots.capacity() * sizeof(uint64_t);
+        }
+
+    private:
+        std::vector<value_type> entries;
+        std::vector<uint64_t> slots; // generation << 32 | index into entries
+        uint32_t generation;
+        size_t shift;
+
+        constexpr static size_t NOT_FOUND = SIZE_MAX;
+        constexpr static size_t INITIAL_CAPACITY = 16;
+        constexpr static size_t MAX_LOAD_NUMERATOR = 1;
+        constexpr static size_t MAX_LOAD_DENOMINATOR = 2;
+
+        uint64_t make_slot(size_t index) const { return ((uint64_t)generation << 32) | index; }
+
+        size_t home(const K &key) const { return (Hash()(key) * 0x9E3779B97F4A7C15ull) >> shift; }
+
+        size_t lookup(const K &key) const
+        {
+            if (entries.empty())
+                return NOT_FOUND;
+            for (size_t pos = home(key);; pos = (pos + 1) & (slots.size() - 1))
+            {
+                auto slot = slots[pos];
+                if ((slot >> 32) != generation)
+                    return NOT_FOUND;
+                if (entries[(uint32_t)slot].first == key)
+                    return (uint32_t)slot;
+            }
+        }
+
+        void grow()
+        {
+            size_t new_capacity = slots.empty() ? INITIAL_CAPACITY : slots.size() * 2;
+            slots.assign(new_capacity, 0);
+            generation = 1;
+            shift = 64 - __builtin_ctzll(new_capacity);
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                auto pos = home(entries[i].first);
+                while ((slots[pos] >> 32) == generation)
+                    pos = (pos + 1) & (slots.size() - 1);
+                slots[pos] = make_slot(i);
+            }
+        }
+    };
+} // namespace livegraph
@@ -15,6 +15,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <stdexcept>
 
@@ -23,6 +24,8 @@
 #include <sys/syscall.h>
 #include <unistd.h>
 
+#include <immintrin.h>
+
 namespace livegraph
 {
     /// @brief 这里的 Futex 类实现了一个互斥锁，其主要方法包括 lock()、try_lock_for() 和 unlock()，分别用于加锁、等待超时后尝试加锁以及解锁。
@@ -92,4 +95,95 @@ namespace livegraph
             return syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
         }
     };
+
+    /// @brief 自适应互斥锁：单个 int 状态字（0 空闲，1 加锁，2 加锁且可能有等待者），竞争时先 _mm_pause 自旋再 FUTEX_WAIT。
+    class AdaptiveFutex
+    {
+    public:
+        void lock()
+        {
+            if (!try_lock())
+                lock_contended(nullptr);
+        }
+
+        bool try_lock()
+        {
+            int expected = UNLOCKED;
+            return __atomic_compare_exchange_n(&state, &expected, LOCKED, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+        }
+
+        template <class Rep, class Period> bool try_lock_for(const std::chrono::duration<Rep, Period> &timeout_duration)
+        {
+            if (try_lock())
+                return true;
+            auto deadline = std::chrono::steady_clock::now() +
+                            std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout_duration);
+            return lock_contended(&deadline);
+        }
+
+        void unlock()
+        {
+            if (__atomic_exchange_n(&state, UNLOCKED, __ATOMIC_RELEASE) == CONTENDED)
+            {
+                int ret = futex(&state, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+                if (ret == -1)
+                    throw std::runtime_error("Futex wake error.");
+            }
+        }
+
+        void clear() { state = UNLOCKED; }
+
+        static size_t get_num_contended() { return num_contended.load(std::memory_order_relaxed); }
+
+        static size_t get_num_parked() { return num_parked.load(std::memory_order_relaxed); }
+
+        AdaptiveFutex() : state(UNLOCKED) {}
+
+    private:
+        int state;
+
+        inline static std::atomic<size_t> num_contended = 0;
+        inline static std::atomic<size_t> num_parked = 0;
+
+        constexpr static int UNLOCKED = 0;
+        constexpr static int LOCKED = 1;
+        constexpr static int CONTENDED = 2;
+        constexpr static size_t SPIN_LIMIT = 128;
+
+        bool lock_contended(const std::chrono::steady_clock::time_point *deadline)
+        {
+            num_contended.fetch_add(1, std::memory_order_relaxed);
+
+            for (size_t i = 0; i < SPIN_LIMIT; i++)
+            {
+                _mm_pause();
+                if (__atomic_load_n(&state, __ATOMIC_RELAXED) == UNLOCKED && try_lock())
+                    return true;
+            }
+
+            num_parked.fetch_add(1, std::memory_order_relaxed);
+            while (__atomic_exchange_n(&state, CONTENDED, __ATOMIC_ACQUIRE) != UNLOCKED)
+            {
+                struct timespec timeout;
+                if (deadline)
+                {
+                    auto remaining = *deadline - std::chrono::steady_clock::now();
+                    if (remaining <= std::chrono::steady_clock::duration::zero())
+                        return false;
+                    timeout.tv_sec = remaining / std::chrono::seconds(1);
+                    timeout.tv_nsec = (remaining % std::chrono::seconds(1)) / std::chrono::nanoseconds(1);
+                }
+                int ret = futex(&state, FUTEX_WAIT_PRIVATE, CONTENDED, deadline ? &timeout : nullptr, nullptr, 0);
+                if (ret == -1 && errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT)
+                    throw std::runtime_error("Futex wait error.");
+            }
+            return true;
+        }
+
+        inline static int
+        futex(int *uaddr, int futex_op, int val, const struct timespec *timeout, int *uaddr2, int val3)
+        {
+            return syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
+        }
+    };
 } // namespace livegraph
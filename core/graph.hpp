@@ -16,9 +16,11 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <memory>
 #include <mutex>
 #include <unordered_set>
+#include <vector>
 
 #include <tbb/concurrent_queue.h>
 #include <tbb/enumerable_thread_specific.h>
@@ -26,7 +28,13 @@
 #include "allocator.hpp"
 #include "block_manager.hpp"
 #include "commit_manager.hpp"
+#include "contention_profiler.hpp"
+#include "edge_change_log.hpp"
 #include "futex.hpp"
+#include "key_index.hpp"
+#include "reader_registry.hpp"
+#include "version_index.hpp"
+#include "vertex_index.hpp"
 
 namespace livegraph
 {
@@ -34,33 +42,96 @@ namespace livegraph
     class EdgeIteratorVersion;
     class Transaction;
 
+    struct TransactionStats
+    {
+        size_t num_wait_die_rollbacks;      // a younger transaction requested a lock held by an older one
+        size_t num_lock_timeout_rollbacks;  // lock waits that exceeded Graph::LOCK_WAIT_TIMEOUT
+        size_t num_write_write_rollbacks;   // a newer version was committed after the read epoch
+        size_t num_read_write_rollbacks;    // serializable mode: something read was overwritten before commit
+        size_t num_executions;              // transactions run by Graph::execute
+        size_t num_execute_retries;         // attempts repeated by Graph::execute after a rollback
+        size_t num_execute_exhausted;       // executions that gave up after ExecuteOptions::max_retries
+    };
+
+    struct ExecuteOptions
+    {
+        size_t max_retries = 16;
+        // The sleep before the i-th retry is drawn uniformly from [0, min(initial_backoff * 2^i, max_backoff)].
+        std::chrono::microseconds initial_backoff = std::chrono::microseconds(20);
+        std::chrono::microseconds max_backoff = std::chrono::milliseconds(10);
+        bool wait_visable = true;
+        bool serializable = false;
+    };
+
+    struct GraphOptions
+    {
+        // Striped (vertex, label) locks, so that writers to different labels of a vertex do not serialize.
+        bool fine_grained_edge_lock = false;
+        // > 1 lets each thread reserve that many vertex ids at a time; Graph::get_max_vertex_id() then also counts
+        // reserved ids that were not handed out yet, which read as nonexistent vertices.
+        vertex_t vertex_id_batch_size = 1;
+        // Compaction and the batch loader leave edge blocks in ascending dst order, which Transaction::intersect and
+        // count_triangles can merge without sorting.
+        bool sort_edge_blocks = false;
+        // With sort_edge_blocks, compaction copies a block only to sort it once more than this many entries were
+        // appended after its sorted prefix; shorter tails are sorted on the fly by the readers.
+        size_t max_unsorted_tail = 64;
+        // > 0 enables the external key index (Transaction::find_or_create_vertex) for that many keys.
+        size_t max_keys = 0;
+    };
+
     class Graph
     {
     public:
         Graph(std::string block_path = "",
               std::string wal_path = "",
               size_t _max_block_size = 1ul << 40,
-              vertex_t _max_vertex_id = 1ul << 40)
+              vertex_t _max_vertex_id = 1ul << 40,
+              const GraphOptions &options = GraphOptions())
             : mutex(),
               epoch_id(0),
               transaction_id(0),
               vertex_id(0),
-              read_epoch_table(NO_TRANSACTION),
+              reader_registry(std::make_shared<ReaderRegistry>(MAX_READERS, NO_TRANSACTION)),
               compact_table(),
               recycled_vertex_ids(),
+              vertex_id_caches(),
+              recycled_vertex_id_batches(),
+              num_wait_die_rollbacks(0),
+              num_lock_timeout_rollbacks(0),
+              num_write_write_rollbacks(0),
+              num_read_write_rollbacks(0),
+              num_executions(0),
+              num_execute_retries(0),
+              num_execute_exhausted(0),
+              contention_profiler(),
               max_vertex_id(_max_vertex_id),
+              vertex_id_batch_size(options.vertex_id_batch_size),
+              sort_edge_blocks(options.sort_edge_blocks),
+              max_unsorted_tail(options.max_unsorted_tail),
               array_allocator(),
               block_manager(block_path, _max_block_size),
-              commit_manager(wal_path, epoch_id)
+              commit_manager(wal_path, epoch_id),
+              key_index(options.max_keys),
+              vertex_indexes(),
+              version_index(),
+              edge_change_log()
         {
             auto futex_allocater =
-                std::allocator_traits<decltype(array_allocator)>::rebind_alloc<Futex>(array_allocator);
+                std::allocator_traits<decltype(array_allocator)>::rebind_alloc<AdaptiveFutex>(array_allocator);
             vertex_futexes = futex_allocater.allocate(max_vertex_id);
+            edge_futexes = options.fine_grained_edge_lock ? futex_allocater.allocate(EDGE_FUTEX_TABLE_SIZE) : nullptr;
 
             auto pointer_allocater =
                 std::allocator_traits<decltype(array_allocator)>::rebind_alloc<uintptr_t>(array_allocator);
             vertex_ptrs = pointer_allocater.allocate(max_vertex_id);
             edge_label_ptrs = pointer_allocater.allocate(max_vertex_id);
+            vertex_key_ptrs = key_index.enabled() ? pointer_allocater.allocate(max_vertex_id) : nullptr;
+
+            auto owner_allocater =
+                std::allocator_traits<decltype(array_allocator)>::rebind_alloc<timestamp_t>(array_allocator);
+            vertex_lock_owners = owner_allocater.allocate(max_vertex_id);
+            edge_lock_owners = options.fine_grained_edge_lock ? owner_allocater.allocate(EDGE_FUTEX_TABLE_SIZE) : nullptr;
         }
 
         Graph(const Graph &) = delete;
@@ -70,23 +141,80 @@ namespace livegraph
         ~Graph() noexcept
         {
             auto futex_allocater =
-                std::allocator_traits<decltype(array_allocator)>::rebind_alloc<Futex>(array_allocator);
+                std::allocator_traits<decltype(array_allocator)>::rebind_alloc<AdaptiveFutex>(array_allocator);
             futex_allocater.deallocate(vertex_futexes, max_vertex_id);
+            if (edge_futexes)
+                futex_allocater.deallocate(edge_futexes, EDGE_FUTEX_TABLE_SIZE);
 
             auto pointer_allocater =
                 std::allocator_traits<decltype(array_allocator)>::rebind_alloc<uintptr_t>(array_allocator);
             pointer_allocater.deallocate(vertex_ptrs, max_vertex_id);
             pointer_allocater.deallocate(edge_label_ptrs, max_vertex_id);
+            if (vertex_key_ptrs)
+                pointer_allocater.deallocate(vertex_key_ptrs, max_vertex_id);
+
+            auto owner_allocater =
+                std::allocator_traits<decltype(array_allocator)>::rebind_alloc<timestamp_t>(array_allocator);
+            owner_allocater.deallocate(vertex_lock_owners, max_vertex_id);
+            if (edge_lock_owners)
+                owner_allocater.deallocate(edge_lock_owners, EDGE_FUTEX_TABLE_SIZE);
         }
 
         vertex_t get_max_vertex_id() const { return vertex_id; }
 
         timestamp_t compact(timestamp_t read_epoch_id = NO_TRANSACTION);
 
-        Transaction begin_transaction();
+        // Rebuilds the key index and vertex_key_ptrs from the committed key blocks in the block region, e.g. once
+        // the region has been restored after a restart; no transaction may run meanwhile.
+        void recover_key_index();
+
+        // A transaction retried after a rollback should pass the priority of its first attempt
+        // (Transaction::get_priority()), so that it ages under wait-die instead of being starved.
+        Transaction begin_transaction(timestamp_t priority = NO_TRANSACTION);
+        // Like begin_transaction, but commit also validates what was read, which rules out write skew.
+        Transaction begin_serializable_transaction(timestamp_t priority = NO_TRANSACTION);
         Transaction begin_read_only_transaction();
         Transaction begin_batch_loader();
 
+        // Runs fn(Transaction &) in a read-write transaction and commits it, retrying on RollbackExcept with
+        // randomized exponential backoff. fn must not commit or abort the transaction itself and may run
+        // several times. Defined in transaction.hpp.
+        template <typename F> auto execute(F &&fn, const ExecuteOptions &options = ExecuteOptions());
+
+        // Secondary index over the vertices for which key_of(data, key) holds, filled from the latest version of
+        // every vertex and then maintained by put_vertex/del_vertex. Must not run concurrently with transactions.
+        // Returns the id to pass to Transaction::find_vertices.
+        size_t create_vertex_index(VertexIndex::Type type, VertexIndex::KeyFunction key_of);
+
+        // Graph-wide index of the edges by version (Transaction::get_edges_by_version), filled from the existing edges
+        // and then maintained at commit. Must not run concurrently with transactions.
+        void create_version_index(size_t partition_bits = VersionIndex::DEFAULT_PARTITION_BITS);
+
+        // Logs the edge lists changed by each commit from now on, for the graph-wide Transaction::get_edge_changes.
+        // Must not run concurrently with transactions.
+        void enable_edge_change_log();
+
+        TransactionStats get_transaction_stats() const
+        {
+            return {num_wait_die_rollbacks.load(std::memory_order_relaxed),
+                    num_lock_timeout_rollbacks.load(std::memory_order_relaxed),
+                    num_write_write_rollbacks.load(std::memory_order_relaxed),
+                    num_read_write_rollbacks.load(std::memory_order_relaxed),
+                    num_executions.load(std::memory_order_relaxed),
+                    num_execute_retries.load(std::memory_order_relaxed),
+                    num_execute_exhausted.load(std::memory_order_relaxed)};
+        }
+
+        // Samples one in sample_period lock waits and rollbacks per thread into a top-K sketch keyed by
+        // (vertex, label); vertex-level events use ContentionProfiler::NO_LABEL.
+        void enable_contention_profiler(size_t sample_period = 1) { contention_profiler.enable(sample_period); }
+        void disable_contention_profiler() { contention_profiler.disable(); }
+        void reset_contention_profiler() { contention_profiler.reset(); }
+        std::vector<ContentionRecord> get_contention_hotspots(size_t k = 16) const
+        {
+            return contention_profiler.top(k);
+        }
+
     private:
         using cacheline_padding_t = char[64];
 
@@ -100,28 +228,97 @@ namespace livegraph
         std::atomic<vertex_t> vertex_id;
         cacheline_padding_t padding4;
 
-        tbb::enumerable_thread_specific<timestamp_t> read_epoch_table;
+        std::shared_ptr<ReaderRegistry> reader_registry;
         tbb::enumerable_thread_specific<std::unordered_set<vertex_t>> compact_table;
 
         tbb::concurrent_queue<vertex_t> recycled_vertex_ids;
 
+        // With vertex_id_batch_size > 1, each thread reserves vertex ids in ranges and keeps recycled ids in a local
+        // magazine; full magazines are handed to other threads through recycled_vertex_id_batches.
+        struct VertexIdCache
+        {
+            vertex_t next = 0;
+            vertex_t end = 0;
+            std::vector<vertex_t> recycled;
+        };
+        tbb::enumerable_thread_specific<VertexIdCache> vertex_id_caches;
+        tbb::concurrent_queue<std::vector<vertex_t>> recycled_vertex_id_batches;
+
+        std::atomic<size_t> num_wait_die_rollbacks;
+        std::atomic<size_t> num_lock_timeout_rollbacks;
+        std::atomic<size_t> num_write_write_rollbacks;
+        std::atomic<size_t> num_read_write_rollbacks;
+        std::atomic<size_t> num_executions;
+        std::atomic<size_t> num_execute_retries;
+        std::atomic<size_t> num_execute_exhausted;
+
+        ContentionProfiler contention_profiler;
+
         const vertex_t max_vertex_id;
+        const vertex_t vertex_id_batch_size;
+        const bool sort_edge_blocks;
+        const size_t max_unsorted_tail;
 
         SparseArrayAllocator<void> array_allocator;
         BlockManager block_manager;
         CommitManager commit_manager;
+        KeyIndex key_index;
+        std::vector<std::unique_ptr<VertexIndex>> vertex_indexes;
+        std::unique_ptr<VersionIndex> version_index;
+        std::unique_ptr<EdgeChangeLog> edge_change_log;
 
-        Futex *vertex_futexes;
+        AdaptiveFutex *vertex_futexes;
+        AdaptiveFutex *edge_futexes; // striped (vertex, label) locks, only with fine-grained edge locking
+        timestamp_t *vertex_lock_owners; // priority of the transaction holding the lock, NO_LOCK_OWNER otherwise
+        timestamp_t *edge_lock_owners;
         uintptr_t *vertex_ptrs;
         uintptr_t *edge_label_ptrs;
+        uintptr_t *vertex_key_ptrs; // KeyBlockHeader of the vertex, only with the key index
+        // Key blocks of rolled back insertions, with the epoch they were unpublished at; compact frees them once
+        // every reader began after that.
+        tbb::enumerable_thread_specific<std::vector<std::pair<uintptr_t, timestamp_t>>> retired_key_blocks;
 
         constexpr static size_t COMPACTION_CYCLE = 1ul << 20;
+        constexpr static size_t MAX_READERS = 4096;
         constexpr static timestamp_t ROLLBACK_TOMBSTONE = INT64_MAX;
         constexpr static timestamp_t NO_TRANSACTION = -1;
         constexpr static timestamp_t RO_TRANSACTION = ROLLBACK_TOMBSTONE - 1;
         constexpr static vertex_t VERTEX_TOMBSTONE = UINT64_MAX;
         constexpr static auto TIMEOUT = std::chrono::milliseconds(1);
+        constexpr static auto LOCK_WAIT_TIMEOUT = std::chrono::milliseconds(100);
+        constexpr static timestamp_t NO_LOCK_OWNER = 0;
         constexpr static size_t COMPACT_EDGE_BLOCK_THRESHOLD = 5; // at least compact 20% edges
+        constexpr static size_t EDGE_FUTEX_TABLE_BITS = 20;
+        constexpr static size_t EDGE_FUTEX_TABLE_SIZE = 1ul << EDGE_FUTEX_TABLE_BITS;
+
+        static size_t get_edge_futex_id(vertex_t vertex_id, label_t label)
+        {
+            return (((vertex_id << 16) | label) * 0x9E3779B97F4A7C15ull) >> (64 - EDGE_FUTEX_TABLE_BITS);
+        }
+
+        Transaction begin_read_write_transaction(timestamp_t priority, bool serializable);
+
+        // Returns an id whose lock and pointer slots are cleared.
+        vertex_t allocate_vertex_id(bool use_recycled_vertex);
+        void recycle_vertex_id(vertex_t vertex_id);
+
+        // Takes the key block of a rolled back insertion out of the key index and vertex_key_ptrs; lookups may
+        // still be reading it, so it is freed by compact.
+        void retire_key_block(uintptr_t pointer);
+        // Marks the block free first, so that recover_key_index skips it.
+        void free_key_block(uintptr_t pointer);
+
+        void clear_vertex_slots(vertex_t vertex_id)
+        {
+            vertex_futexes[vertex_id].clear();
+            vertex_ptrs[vertex_id] = block_manager.NULLPOINTER;
+            edge_label_ptrs[vertex_id] = block_manager.NULLPOINTER;
+            if (vertex_key_ptrs)
+                vertex_key_ptrs[vertex_id] = block_manager.NULLPOINTER;
+        }
+
+        // Read epoch slot of the calling thread, registered on first use and cached per thread.
+        std::atomic<timestamp_t> &get_reader_slot();
 
         friend class EdgeIterator;
         friend class EdgeIteratorVersion;
@@ -0,0 +1,159 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#ifdef __SSSE3__
+#include <immintrin.h>
+#endif
+
+namespace livegraph
+{
+    /**
+     * 十六进制文本与二进制之间的转换，用于哈希类标识符（地址、摘要）的 API 边界。
+     * 支持 SSSE3 时每次处理 16 个字符（解码）或 16 个字节（编码），其余部分逐字节处理。
+     */
+    class Hex
+    {
+    public:
+        // Decodes exactly 2 * size hex digits, with an optional 0x prefix and in either case, into out.
+        static bool decode(std::string_view text, char *out, size_t size)
+        {
+            if (text.size() >= 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+                text.remove_prefix(2);
+            if (text.size() != size * 2)
+                return false;
+            size_t i = 0;
+#ifdef __SSSE3__
+            const __m128i zero = _mm_set1_epi8('0'), nine = _mm_set1_epi8(9), lower_a = _mm_set1_epi8('a'),
+                          five = _mm_set1_epi8(5), case_bit = _mm_set1_epi8(0x20), ten = _mm_set1_epi8(10);
+            for (; i + 16 <= text.size(); i += 16)
+            {
+                __m128i chars = _mm_loadu_si128((const __m128i *)(text.data() + i));
+                __m128i digits = _mm_sub_epi8(chars, zero);
+                __m128i letters = _mm_sub_epi8(_mm_or_si128(chars, case_bit), lower_a);
+                // Unsigned x <= bound iff min(x, bound) == x
+                __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digits, nine), digits);
+                __m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letters, five), letters);
+                if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) != 0xffff)
+                    return false;
+                __m128i values =
+                    _mm_or_si128(_mm_and_si128(is_digit, digits), _mm_and_si128(is_letter, _mm_add_epi8(letters, ten)));
+                // Pairs of nibbles to bytes: high * 16 + low
+                __m128i bytes = _mm_maddubs_epi16(values, _mm_set1_epi16(0x0110));
+                _mm_storel_epi64((__m128i *)(out + i / 2), _mm_packus_epi16(bytes, bytes));
+            }
+#endif
+            for (; i < text.size(); i += 2)
+            {
+                int high = nibble(text[i]), low = nibble(text[i + 1]);
+                if (high < 0 || low < 0)
+                    return false;
+                out[i / 2] = (char)(high << 4 | low);
+            }
+            return true;
+        }
+
+        // Writes 2 * size lowercase hex digits to out.
+        static void encode(const char *data, size_t size, char *out)
+        {
+            size_t i = 0;
+#ifdef __SSSE3__
+            const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd',
+                                                 'e', 'f');
+            const __m128i mask = _mm_set1_epi8(0x0f);
+            for (; i + 16 <= size; i += 16)
+            {
+                __m128i bytes = _mm_loadu_si128((const __m128i *)(data + i));
+                __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+                __m128i low = _mm_and_si128(bytes, mask);
+                _mm_storeu_si128((__m128i *)(out + i * 2), _mm_shuffle_epi8(digits, _mm_unpacklo_epi8(high, low)));
+                _mm_storeu_si128((__m128i *)(out + i * 2 + 16),
+                                 _mm_shuffle_epi8(digits, _mm_unpackhi_epi8(high, low)));
+            }
+#endif
+            for (; i < size; i++)
+            {
+                out[i * 2] = DIGITS[(unsigned char)data[i] >> 4];
+                out[i * 2 + 1] = DIGITS[(unsigned char)data[i] & 0x0f];
+            }
+        }
+
+        static std::string encode(std::string_view data, bool prefix = true)
+        {
+            std::string text(prefix ? 2 : 0, 'x');
+            if (prefix)
+                text[0] = '0';
+            text.resize(text.size() + data.size() * 2);
+            encode(data.data(), data.size(), text.data() + (prefix ? 2 : 0));
+            return text;
+        }
+
+    private:
+        constexpr static char DIGITS[] = "0123456789abcdef";
+
+        static int nibble(char c)
+        {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            c |= 0x20;
+            if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+            return -1;
+        }
+    };
+
+    // A fixed-width binary identifier, e.g. a 20-byte address or a 32-byte digest. As an external key
+    // (Transaction::find_or_create_vertex) or as vertex data it takes half the space of its hex text.
+    template <size_t N> struct FixedKey
+    {
+        std::array<char, N> bytes;
+
+        static FixedKey from_hex(std::string_view text)
+        {
+            FixedKey key;
+            if (!Hex::decode(text, key.bytes.data(), N))
+                throw std::invalid_argument("Invalid hex key: " + std::string(text) + ".");
+            return key;
+        }
+
+        // Reinterprets a key or vertex data written from a FixedKey<N>.
+        static FixedKey from_bytes(std::string_view data)
+        {
+            if (data.size() != N)
+                throw std::invalid_argument("The key width does not match.");
+            FixedKey key;
+            std::copy(data.begin(), data.end(), key.bytes.begin());
+            return key;
+        }
+
+        std::string_view view() const { return std::string_view(bytes.data(), N); }
+
+        std::string to_hex(bool prefix = true) const { return Hex::encode(view(), prefix); }
+
+        bool operator==(const FixedKey &other) const { return bytes == other.bytes; }
+        bool operator!=(const FixedKey &other) const { return bytes != other.bytes; }
+    };
+
+    using Address = FixedKey<20>;
+    using Digest = FixedKey<32>;
+} // namespace livegraph
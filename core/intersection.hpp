@@ -0,0 +1,122 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "types.hpp"
+
+namespace livegraph
+{
+    /**
+     * 有序、无重复的顶点数组求交。
+     * 两边长度相差很大时对短的一边逐个二分（galloping），否则做归并；
+     * 支持 AVX2 时归并每次比较 4x4 个元素。
+     * out 为 nullptr 时只计数；out 可以与 a 或 b 相同（原地求交）。
+     */
+    class SortedIntersection
+    {
+    public:
+        static size_t intersect(const vertex_t *a, size_t na, const vertex_t *b, size_t nb, vertex_t *out = nullptr)
+        {
+            if (na > nb)
+            {
+                std::swap(a, b);
+                std::swap(na, nb);
+            }
+            if (na * GALLOP_RATIO < nb)
+                return gallop(a, na, b, nb, out);
+            return merge(a, na, b, nb, out);
+        }
+
+        constexpr static size_t GALLOP_RATIO = 32;
+
+    private:
+        static size_t gallop(const vertex_t *a, size_t na, const vertex_t *b, size_t nb, vertex_t *out)
+        {
+            size_t count = 0;
+            auto cursor = b, end = b + nb;
+            for (size_t i = 0; i < na && cursor != end; i++)
+            {
+                // Exponential search from the cursor, then binary search within the bracket
+                size_t step = 1;
+                while (cursor + step < end && cursor[step] < a[i])
+                    step <<= 1;
+                cursor = std::lower_bound(cursor + (step >> 1), std::min(cursor + step + 1, end), a[i]);
+                if (cursor != end && *cursor == a[i])
+                {
+                    if (out)
+                        out[count] = a[i];
+                    count++;
+                }
+            }
+            return count;
+        }
+
+        static size_t merge(const vertex_t *a, size_t na, const vertex_t *b, size_t nb, vertex_t *out)
+        {
+            size_t i = 0, j = 0, count = 0;
+#ifdef __AVX2__
+            while (i + 4 <= na && j + 4 <= nb)
+            {
+                __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+                __m256i vb = _mm256_loadu_si256((const __m256i *)(b + j));
+                // Compare every element of va with all four rotations of vb
+                __m256i match = _mm256_cmpeq_epi64(va, vb);
+                match = _mm256_or_si256(match, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, 0x39)));
+                match = _mm256_or_si256(match, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, 0x4e)));
+                match = _mm256_or_si256(match, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, 0x93)));
+                unsigned mask = _mm256_movemask_pd(_mm256_castsi256_pd(match));
+                if (out)
+                {
+                    for (unsigned bits = mask; bits; bits &= bits - 1)
+                        out[count++] = a[i + __builtin_ctz(bits)];
+                }
+                else
+                {
+                    count += __builtin_popcount(mask);
+                }
+                auto a_max = a[i + 3], b_max = b[j + 3];
+                if (a_max <= b_max)
+                    i += 4;
+                if (b_max <= a_max)
+                    j += 4;
+            }
+#endif
+            while (i < na && j < nb)
+            {
+                if (a[i] < b[j])
+                    i++;
+                else if (b[j] < a[i])
+                    j++;
+                else
+                {
+                    if (out)
+                        out[count] = a[i];
+                    count++;
+                    i++;
+                    j++;
+                }
+            }
+            return count;
+        }
+    };
+} // namespace livegraph
@@ -0,0 +1,178 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+
+#include <tbb/spin_mutex.h>
+
+#include "allocator.hpp"
+#include "types.hpp"
+
+namespace livegraph
+{
+    /**
+     * 外部主键到顶点的无锁哈希索引：线性探测的开放寻址表，每个槽是一个 64 位字，
+     * 高 16 位是哈希标签，低 48 位是块区域中 KeyBlockHeader 的指针。
+     * 槽从空或墓碑变为占用（CAS）；回滚的插入把自己的槽置为墓碑，之后任何键都可以重用，查找越过墓碑继续探测，
+     * 因此查找不需要加锁。同一个键的插入按哈希分条加锁串行化，保证不会在两个槽中各插入一份。
+     * 键的可见性（提交、回滚）由 KeyBlockHeader 的 creation_time 决定，由 Transaction 判断。
+     */
+    class KeyIndex
+    {
+    public:
+        // Room for max_keys keys at a load factor of at most 1/2; 0 disables the index.
+        explicit KeyIndex(size_t max_keys) : capacity(0), slots(nullptr), insert_mutexes()
+        {
+            if (max_keys == 0)
+                return;
+            capacity = 1;
+            while (capacity < max_keys * 2)
+                capacity <<= 1;
+            slots = SparseArrayAllocator<std::atomic<uint64_t>>().allocate(capacity);
+            insert_mutexes = std::make_unique<tbb::spin_mutex[]>(NUM_INSERT_MUTEXES);
+        }
+
+        KeyIndex(const KeyIndex &) = delete;
+
+        ~KeyIndex() noexcept
+        {
+            if (slots)
+                SparseArrayAllocator<std::atomic<uint64_t>>().deallocate(slots, capacity);
+        }
+
+        bool enabled() const { return slots; }
+
+        // Empties every slot; no lookup or insert may run meanwhile.
+        void clear()
+        {
+            for (size_t i = 0; i < capacity; i++)
+                slots[i].store(EMPTY, std::memory_order_relaxed);
+        }
+
+        // A word at a time, so that fixed-width binary keys (FixedKey) hash in a few multiplications
+        static uint64_t hash(std::string_view key)
+        {
+            uint64_t hash = key.size() * 0x9e3779b97f4a7c15ull, word;
+            size_t i = 0;
+            for (; i + sizeof(word) <= key.size(); i += sizeof(word))
+            {
+                std::memcpy(&word, key.data() + i, sizeof(word));
+                hash = (hash ^ word) * 0xbf58476d1ce4e5b9ull;
+                hash ^= hash >> 29;
+            }
+            if (i < key.size())
+            {
+                word = 0;
+                std::memcpy(&word, key.data() + i, key.size() - i);
+                hash = (hash ^ word) * 0xbf58476d1ce4e5b9ull;
+                hash ^= hash >> 29;
+            }
+            hash = (hash ^ (hash >> 32)) * 0x94d049bb133111ebull;
+            return hash ^ (hash >> 29);
+        }
+
+        // Calls match(pointer) for the keys with a matching hash tag in probe order; returns the first pointer
+        // match accepts, or NOT_FOUND when an empty slot ends the probe sequence.
+        template <typename F> uintptr_t find(uint64_t hash, F &&match) const
+        {
+            for (size_t i = 0, index = hash & (capacity - 1); i < capacity; i++, index = (index + 1) & (capacity - 1))
+            {
+                auto slot = slots[index].load(std::memory_order_acquire);
+                if (slot == EMPTY)
+                    return NOT_FOUND;
+                if (slot >> POINTER_BITS == get_tag(hash) && match(slot & POINTER_MASK))
+                    return slot & POINTER_MASK;
+            }
+            return NOT_FOUND;
+        }
+
+        // Publishes pointer in the first empty or tombstoned slot, unless find(hash, match) finds the key (e.g.
+        // inserted concurrently), whose pointer is returned instead. Inserts of the same hash are serialized, so
+        // the key cannot end up in two slots; a slot taken by another key meanwhile restarts the probe.
+        template <typename F> uintptr_t insert(uint64_t hash, uintptr_t pointer, F &&match)
+        {
+            tbb::spin_mutex::scoped_lock lock(insert_mutexes[hash % NUM_INSERT_MUTEXES]);
+            const uint64_t new_slot = get_tag(hash) << POINTER_BITS | pointer;
+            while (true)
+            {
+                size_t free_index = capacity;
+                uint64_t free_slot = EMPTY;
+                for (size_t i = 0, index = hash & (capacity - 1); i < capacity;
+                     i++, index = (index + 1) & (capacity - 1))
+                {
+                    auto slot = slots[index].load(std::memory_order_acquire);
+                    if (slot == EMPTY || slot == TOMBSTONE)
+                    {
+                        if (free_index == capacity)
+                        {
+                            free_index = index;
+                            free_slot = slot;
+                        }
+                        if (slot == EMPTY)
+                            break;
+                    }
+                    else if (slot >> POINTER_BITS == get_tag(hash) && match(slot & POINTER_MASK))
+                    {
+                        return slot & POINTER_MASK;
+                    }
+                }
+                if (free_index == capacity)
+                    throw std::runtime_error("The key index is full.");
+                if (slots[free_index].compare_exchange_strong(free_slot, new_slot, std::memory_order_acq_rel))
+                    return pointer;
+            }
+        }
+
+        // Turns the slot of pointer into a tombstone (a rolled back insertion). Lookups that already loaded the
+        // pointer may still read its block, so the block is only freed once they are done.
+        void remove(uint64_t hash, uintptr_t pointer)
+        {
+            uint64_t old_slot = get_tag(hash) << POINTER_BITS | pointer;
+            for (size_t i = 0, index = hash & (capacity - 1); i < capacity; i++, index = (index + 1) & (capacity - 1))
+            {
+                auto slot = slots[index].load(std::memory_order_acquire);
+                if (slot == EMPTY)
+                    return;
+                if (slot == old_slot)
+                {
+                    slots[index].compare_exchange_strong(old_slot, TOMBSTONE, std::memory_order_acq_rel);
+                    return;
+                }
+            }
+        }
+
+        constexpr static uintptr_t NOT_FOUND = UINTPTR_MAX;
+
+    private:
+        size_t capacity;
+        std::atomic<uint64_t> *slots;
+        std::unique_ptr<tbb::spin_mutex[]> insert_mutexes;
+
+        constexpr static uint64_t EMPTY = 0;
+        constexpr static uint64_t TOMBSTONE = 1; // tag 0, which no occupied slot has
+        constexpr static size_t NUM_INSERT_MUTEXES = 1024;
+        constexpr static size_t POINTER_BITS = 48;
+        constexpr static uint64_t POINTER_MASK = (1ul << POINTER_BITS) - 1;
+
+        // Never 0, so that an occupied slot differs from EMPTY even for block offset 0
+        static uint64_t get_tag(uint64_t hash) { return (hash >> POINTER_BITS) | 1; }
+    };
+} // namespace livegraph
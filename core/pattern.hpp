@@ -0,0 +1,196 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "types.hpp"
+
+namespace livegraph
+{
+    struct PatternEdge
+    {
+        size_t src; // pattern vertices
+        size_t dst;
+        label_t label;
+        // With windowed, the edges whose version lies in [start, end] as get_edges_with_version returns them;
+        // otherwise the edges visible in the snapshot.
+        bool windowed = false;
+        timestamp_t start = 0;
+        timestamp_t end = 0;
+        // Label under which the application stores this edge reversed (dst -> src), so that the edge can be
+        // followed from dst as well.
+        label_t reverse_label = NO_REVERSE_LABEL;
+
+        constexpr static label_t NO_REVERSE_LABEL = std::numeric_limits<label_t>::max();
+    };
+
+    /**
+     * 子图模式：若干模式顶点和带标签、版本区间约束的有向边。
+     * Transaction::match_pattern 用 generic join 执行：按 plan() 给出的顺序逐个绑定模式顶点，
+     * 每个顶点的候选集是已绑定邻居的有序邻接表之交。
+     * 只有出边可以直接遍历；没有 reverse_label 的边若只能从 dst 一侧到达，就在绑定 src 后检查。
+     */
+    class Pattern
+    {
+    public:
+        // With injective, distinct pattern vertices are bound to distinct graph vertices.
+        explicit Pattern(size_t _num_vertices, bool _injective = true)
+            : num_vertices(_num_vertices), injective(_injective), edges()
+        {
+            if (num_vertices == 0 || num_vertices > MAX_VERTICES)
+                throw std::invalid_argument("Invalid number of pattern vertices.");
+        }
+
+        Pattern &add_edge(const PatternEdge &edge)
+        {
+            if (edge.src >= num_vertices || edge.dst >= num_vertices)
+                throw std::invalid_argument("The pattern vertex is invalid.");
+            edges.push_back(edge);
+            return *this;
+        }
+
+        Pattern &add_edge(size_t src, size_t dst, label_t label) { return add_edge(PatternEdge{src, dst, label}); }
+
+        Pattern &add_edge(size_t src, size_t dst, label_t label, timestamp_t start, timestamp_t end)
+        {
+            return add_edge(PatternEdge{src, dst, label, true, start, end});
+        }
+
+        size_t get_num_vertices() const { return num_vertices; }
+
+        bool is_injective() const { return injective; }
+
+        const std::vector<PatternEdge> &get_edges() const { return edges; }
+
+        struct Plan
+        {
+            // An adjacency list fetched once owner is bound: the out-edges of the pattern edge, or its reversed
+            // edges when reverse is set.
+            struct Slot
+            {
+                size_t owner;
+                size_t edge;
+                bool reverse;
+            };
+
+            std::vector<size_t> order; // pattern vertices in binding order
+            std::vector<Slot> slots;
+            std::vector<std::vector<size_t>> fetches; // per depth: slots to fill after binding order[depth]
+            std::vector<std::vector<size_t>> extends; // per depth: slots intersected into the candidates
+            // per depth: (slot, pattern vertex) pairs, the slot must contain the vertex bound to the pattern vertex
+            std::vector<std::vector<std::pair<size_t, size_t>>> checks;
+        };
+
+        // Greedy generic-join order: every next vertex is the one that the most bound vertices can reach, so that
+        // its candidates are the intersection of as many adjacency lists as possible.
+        Plan plan() const
+        {
+            if (edges.empty())
+                throw std::invalid_argument("The pattern has no edges.");
+
+            std::vector<size_t> degrees(num_vertices, 0);
+            for (const auto &edge : edges)
+            {
+                degrees[edge.src]++;
+                degrees[edge.dst]++;
+            }
+
+            for (auto root : roots_by_degree(degrees))
+            {
+                std::vector<bool> bound(num_vertices, false);
+                std::vector<size_t> order{root};
+                bound[root] = true;
+                while (order.size() < num_vertices)
+                {
+                    size_t best = num_vertices, best_reach = 0;
+                    for (size_t v = 0; v < num_vertices; v++)
+                    {
+                        if (bound[v])
+                            continue;
+                        size_t reach = 0;
+                        for (const auto &edge : edges)
+                            reach += (edge.dst == v && edge.src != v && bound[edge.src]) ||
+                                     (edge.src == v && edge.dst != v && bound[edge.dst] &&
+                                      edge.reverse_label != PatternEdge::NO_REVERSE_LABEL);
+                        if (reach > best_reach || (reach && reach == best_reach && degrees[v] > degrees[best]))
+                        {
+                            best = v;
+                            best_reach = reach;
+                        }
+                    }
+                    if (best == num_vertices)
+                        break;
+                    order.push_back(best);
+                    bound[best] = true;
+                }
+                if (order.size() == num_vertices)
+                    return build_plan(std::move(order));
+            }
+            throw std::invalid_argument("Every pattern vertex must be reachable along pattern edges.");
+        }
+
+        constexpr static size_t MAX_VERTICES = 16;
+
+    private:
+        size_t num_vertices;
+        bool injective;
+        std::vector<PatternEdge> edges;
+
+        std::vector<size_t> roots_by_degree(const std::vector<size_t> &degrees) const
+        {
+            std::vector<size_t> roots(num_vertices);
+            for (size_t v = 0; v < num_vertices; v++)
+                roots[v] = v;
+            std::stable_sort(roots.begin(), roots.end(), [&](size_t a, size_t b) { return degrees[a] > degrees[b]; });
+            return roots;
+        }
+
+        Plan build_plan(std::vector<size_t> order) const
+        {
+            Plan plan;
+            std::vector<size_t> depths(num_vertices);
+            for (size_t depth = 0; depth < num_vertices; depth++)
+                depths[order[depth]] = depth;
+            plan.order = std::move(order);
+            plan.fetches.resize(num_vertices);
+            plan.extends.resize(num_vertices);
+            plan.checks.resize(num_vertices);
+
+            auto add_slot = [&](size_t owner, size_t edge, bool reverse) {
+                plan.slots.push_back(Plan::Slot{owner, edge, reverse});
+                plan.fetches[depths[owner]].push_back(plan.slots.size() - 1);
+                return plan.slots.size() - 1;
+            };
+
+            for (size_t i = 0; i < edges.size(); i++)
+            {
+                auto src = edges[i].src, dst = edges[i].dst;
+                if (src != dst && depths[src] < depths[dst])
+                    plan.extends[depths[dst]].push_back(add_slot(src, i, false));
+                else if (src != dst && edges[i].reverse_label != PatternEdge::NO_REVERSE_LABEL)
+                    plan.extends[depths[src]].push_back(add_slot(dst, i, true));
+                else
+                    plan.checks[depths[src]].emplace_back(add_slot(src, i, false), dst);
+            }
+            return plan;
+        }
+    };
+} // namespace livegraph
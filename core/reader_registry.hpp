@@ -0,0 +1,134 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "types.hpp"
+
+namespace livegraph
+{
+    /**
+     * 读者登记表：每个线程占用一个独立缓存行的槽位，用于发布其读 epoch，
+     * compaction 扫描所有已分配的槽位求最小读 epoch。
+     * 槽位通过 ReaderHandle 申请，句柄析构（通常是线程退出）时归还。
+     */
+    class ReaderRegistry
+    {
+    public:
+        struct alignas(64) Slot
+        {
+            std::atomic<timestamp_t> read_epoch_id;
+        };
+
+        ReaderRegistry(size_t _max_readers, timestamp_t _idle)
+            : max_readers(_max_readers), idle(_idle), slots(new Slot[_max_readers]), num_slots(0), mutex(), free_slots()
+        {
+            for (size_t i = 0; i < max_readers; i++)
+                slots[i].read_epoch_id.store(idle, std::memory_order_relaxed);
+        }
+
+        ReaderRegistry(const ReaderRegistry &) = delete;
+
+        ReaderRegistry(ReaderRegistry &&) = delete;
+
+        size_t acquire()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!free_slots.empty())
+            {
+                auto slot = free_slots.back();
+                free_slots.pop_back();
+                return slot;
+            }
+            auto slot = num_slots.load(std::memory_order_relaxed);
+            if (slot >= max_readers)
+                throw std::runtime_error("Too many reader threads.");
+            num_slots.store(slot + 1, std::memory_order_release);
+            return slot;
+        }
+
+        void release(size_t slot)
+        {
+            slots[slot].read_epoch_id.store(idle, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(mutex);
+            free_slots.push_back(slot);
+        }
+
+        std::atomic<timestamp_t> &get(size_t slot) { return slots[slot].read_epoch_id; }
+
+        template <typename F> void for_each(F &&f) const
+        {
+            auto n = num_slots.load(std::memory_order_acquire);
+            for (size_t i = 0; i < n; i++)
+                f(slots[i].read_epoch_id.load(std::memory_order_acquire));
+        }
+
+    private:
+        const size_t max_readers;
+        const timestamp_t idle;
+        std::unique_ptr<Slot[]> slots;
+        std::atomic<size_t> num_slots; // high-water mark
+        std::mutex mutex;
+        std::vector<size_t> free_slots;
+    };
+
+    // Owns one slot of a registry. The registry is shared so that a handle cached by a thread can outlive the Graph.
+    class ReaderHandle
+    {
+    public:
+        explicit ReaderHandle(std::shared_ptr<ReaderRegistry> _registry)
+            : registry(std::move(_registry)), slot(registry->acquire())
+        {
+        }
+
+        ReaderHandle(const ReaderHandle &) = delete;
+
+        ReaderHandle(ReaderHandle &&handle) : registry(std::move(handle.registry)), slot(handle.slot) {}
+
+        ReaderHandle &operator=(ReaderHandle &&handle)
+        {
+            if (this != &handle)
+            {
+                if (registry)
+                    registry->release(slot);
+                registry = std::move(handle.registry);
+                slot = handle.slot;
+            }
+            return *this;
+        }
+
+        ~ReaderHandle()
+        {
+            if (registry)
+                registry->release(slot);
+        }
+
+        const ReaderRegistry *get_registry() const { return registry.get(); }
+
+        bool is_orphan() const { return registry.use_count() == 1; }
+
+        std::atomic<timestamp_t> &get_read_epoch_id() { return registry->get(slot); }
+
+    private:
+        std::shared_ptr<ReaderRegistry> registry;
+        size_t slot;
+    };
+} // namespace livegraph
@@ -15,19 +15,106 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
 #include <deque>
-#include <map>
+#include <functional>
+#include <memory>
+#include <random>
 #include <string_view>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
 #include "blocks.hpp"
+#include "csr.hpp"
+#include "edge_iterator.hpp"
+#include "flat_hash_map.hpp"
+#include "intersection.hpp"
+#include "pattern.hpp"
 #include "graph.hpp"
 #include "utils.hpp"
 
 namespace livegraph
 {
+    // Per-transaction containers. They are kept in a small per-thread pool and cleared between transactions, so
+    // that short transactions reuse the memory instead of going through malloc/free for every cache.
+    struct TransactionState
+    {
+        std::string wal;
+
+        std::unordered_map<vertex_t, uintptr_t> vertex_ptr_cache;
+        FlatHashMap<std::pair<vertex_t, label_t>, uintptr_t> edge_ptr_cache;
+        std::vector<std::pair<uintptr_t, order_t>> block_cache;
+        FlatHashMap<EdgeBlockHeader *, std::pair<size_t, size_t>> edge_block_num_entries_data_length_cache;
+        std::vector<vertex_t> new_vertex_cache;
+        std::deque<vertex_t> recycled_vertex_cache;
+
+        std::unordered_set<vertex_t> acquired_locks;
+        std::unordered_set<size_t> acquired_edge_locks;
+        std::vector<std::pair<timestamp_t *, timestamp_t>> timestamps_to_update;
+        // Key blocks published in the key index, retired if the transaction rolls back
+        std::vector<uintptr_t> new_key_blocks;
+
+        // Only tracked in serializable mode: (src, label) and vertices read before being written by this transaction.
+        std::vector<vertex_t> read_vertices;
+        std::vector<std::pair<vertex_t, label_t>> read_edges;
+        // Whole-graph scans are validated over every vertex instead: the labels scanned, and whether vertices were.
+        std::vector<label_t> scanned_labels;
+        bool scanned_vertices = false;
+
+        // Only tracked by the batch loader with Graph::sort_edge_blocks: edge blocks to sort at commit.
+        std::vector<std::pair<vertex_t, label_t>> unsorted_edge_blocks;
+
+        // Only tracked with Graph::create_version_index: edges added to the version index at commit.
+        std::vector<VersionIndexEntry> versioned_edges;
+
+        // Only tracked with Graph::enable_edge_change_log: edge lists written, logged at commit.
+        std::vector<std::pair<vertex_t, label_t>> changed_edges;
+
+        // Clearing a hash table touches every bucket, so tables (and buffers) grown by a large transaction are
+        // released rather than kept for the next small one.
+        void clear()
+        {
+            reset(wal, wal.capacity());
+            reset(vertex_ptr_cache, vertex_ptr_cache.bucket_count());
+            reset(edge_ptr_cache, edge_ptr_cache.capacity());
+            reset(block_cache, block_cache.capacity());
+            reset(edge_block_num_entries_data_length_cache, edge_block_num_entries_data_length_cache.capacity());
+            reset(new_vertex_cache, new_vertex_cache.capacity());
+            recycled_vertex_cache.clear();
+            reset(acquired_locks, acquired_locks.bucket_count());
+            reset(acquired_edge_locks, acquired_edge_locks.bucket_count());
+            reset(timestamps_to_update, timestamps_to_update.capacity());
+            reset(new_key_blocks, new_key_blocks.capacity());
+            reset(read_vertices, read_vertices.capacity());
+            reset(read_edges, read_edges.capacity());
+            reset(scanned_labels, scanned_labels.capacity());
+            scanned_vertices = false;
+            reset(unsorted_edge_blocks, unsorted_edge_blocks.capacity());
+            reset(versioned_edges, versioned_edges.capacity());
+            reset(changed_edges, changed_edges.capacity());
+        }
+
+        constexpr static size_t MAX_POOLED_CAPACITY = 1ul << 12;
+
+    private:
+        template <typename T> static void reset(T &container, size_t capacity)
+        {
+            if (capacity > MAX_POOLED_CAPACITY)
+                T().swap(container);
+            else
+                container.clear();
+        }
+    };
+
     class Transaction
     {
         enum class OPType
@@ -37,6 +124,7 @@ namespace livegraph
             DelVertex,
             PutEdge,
             DelEdge,
+            PutKey,
         };
 
     public:
@@ -47,24 +135,25 @@ namespace livegraph
             RollbackExcept(const char *what_arg) : std::runtime_error(what_arg) {}
         };
 
-        Transaction(
-            Graph &_graph, timestamp_t _local_txn_id, timestamp_t _read_epoch_id, bool _batch_update, bool _trace_cache)
+        Transaction(Graph &_graph,
+                    timestamp_t _local_txn_id,
+                    timestamp_t _read_epoch_id,
+                    bool _batch_update,
+                    bool _trace_cache,
+                    std::atomic<timestamp_t> &_reader_slot,
+                    timestamp_t _priority = Graph::NO_LOCK_OWNER,
+                    bool _serializable = false)
             : graph(_graph),
               local_txn_id(_local_txn_id),
+              priority(_priority),
               read_epoch_id(_read_epoch_id),
               batch_update(_batch_update),
               trace_cache(_trace_cache),
+              serializable(_serializable),
+              reader_slot(_reader_slot),
               write_epoch_id(batch_update ? read_epoch_id : -local_txn_id),
               valid(true),
-              wal(),
-              vertex_ptr_cache(),
-              edge_ptr_cache(),
-              block_cache(),
-              edge_block_num_entries_data_length_cache(),
-              new_vertex_cache(),
-              recycled_vertex_cache(),
-              acquired_locks(),
-              timestamps_to_update()
+              state(acquire_state())
         {
             wal_append((uint64_t)0); // number of operations
             wal_append(read_epoch_id);
@@ -76,30 +165,45 @@ namespace livegraph
         Transaction(Transaction &&txn)
             : graph(txn.graph),
               local_txn_id(std::move(txn.local_txn_id)),
+              priority(std::move(txn.priority)),
               read_epoch_id(std::move(txn.read_epoch_id)),
               batch_update(std::move(txn.batch_update)),
               trace_cache(std::move(txn.trace_cache)),
+              serializable(std::move(txn.serializable)),
+              reader_slot(txn.reader_slot),
               write_epoch_id(std::move(txn.write_epoch_id)),
               valid(std::move(txn.valid)),
-              wal(std::move(txn.wal)),
-              vertex_ptr_cache(std::move(txn.vertex_ptr_cache)),
-              edge_ptr_cache(std::move(txn.edge_ptr_cache)),
-              block_cache(std::move(txn.block_cache)),
-              edge_block_num_entries_data_length_cache(std::move(txn.edge_block_num_entries_data_length_cache)),
-              new_vertex_cache(std::move(txn.new_vertex_cache)),
-              recycled_vertex_cache(std::move(txn.recycled_vertex_cache)),
-              acquired_locks(std::move(txn.acquired_locks)),
-              timestamps_to_update(std::move(txn.timestamps_to_update))
+              state(std::move(txn.state))
         {
             txn.valid = false;
         }
 
         timestamp_t get_read_epoch_id() const { return read_epoch_id; }
 
+        // Lower is older; an older transaction waits for younger lock holders, a younger one is rolled back.
+        timestamp_t get_priority() const { return priority; }
+
         vertex_t new_vertex(bool use_recycled_vertex = false);
         void put_vertex(vertex_t vertex_id, std::string_view data);
         bool del_vertex(vertex_t vertex_id, bool recycle = false);
 
+        // External keys (GraphOptions::max_keys > 0). A key is bound to one vertex for good: a vertex
+        // created under a key keeps it after del_vertex, so keyed vertices should not be deleted with recycle.
+        // Returns the vertex of key, and whether this call created it with new_vertex. A key being inserted by a
+        // concurrent transaction, or committed after the read epoch, is a write-write conflict.
+        std::pair<vertex_t, bool> find_or_create_vertex(std::string_view key, bool use_recycled_vertex = false);
+        // NO_VERTEX if key has no vertex in the snapshot; lock-free, also for read-only transactions.
+        vertex_t find_vertex(std::string_view key);
+        // Empty if the vertex has no key in the snapshot.
+        std::string_view get_vertex_key(vertex_t vertex_id);
+
+        constexpr static vertex_t NO_VERTEX = UINT64_MAX;
+
+        // Vertices whose key in the vertex index (Graph::create_vertex_index) equals key in the snapshot, and for an
+        // ordered index those with a key in [low, high], in key order. Not supported by serializable transactions.
+        std::vector<vertex_t> find_vertices(size_t index_id, std::string_view key);
+        std::vector<vertex_t> find_vertices(size_t index_id, std::string_view low, std::string_view high);
+
         void put_edge(vertex_t src, label_t label, vertex_t dst, std::string_view edge_data, bool force_insert = false);
         void put_edge_with_version(vertex_t src, label_t label, vertex_t dst, std::string_view edge_data, int version, bool force_insert = false);
         bool del_edge(vertex_t src, label_t label, vertex_t dst);
@@ -112,6 +216,88 @@ namespace livegraph
         std::vector<std::string_view> get_edge_with_version(vertex_t src, label_t label, vertex_t dst, timestamp_t start, timestamp_t end);
         EdgeIterator get_edges(vertex_t src, label_t label, bool reverse = false);
         EdgeIteratorVersion get_edges_with_version(vertex_t src, label_t label, timestamp_t start, timestamp_t end, bool reverse = false);
+        // The label edges visible in the snapshot with a version in [start, end], of every source, in version
+        // order; data points into the edge blocks as with get_edges. Needs Graph::create_version_index. The cost
+        // follows the edge lists of the sources with versions in the window, not the graph size.
+        // Not supported by serializable transactions.
+        std::vector<VersionedEdge> get_edges_by_version(label_t label, timestamp_t start, timestamp_t end);
+
+        // The net difference of the label edges of src between the snapshots at e1 and e2 (e1 <= e2 <= the read
+        // epoch): edges visible at e2 but not at e1 as inserted at their creation time, the reverse as deleted at their
+        // deletion time; an update is a deletion plus an insertion. Compaction only keeps deleted edges while some
+        // transaction reads before their deletion, so a transaction kept open at e1 guarantees every deletion is seen.
+        std::vector<EdgeChange> get_edge_changes(vertex_t src, label_t label, timestamp_t e1, timestamp_t e2);
+        // Same for every src, visiting only the edge lists logged as changed after e1 (Graph::enable_edge_change_log,
+        // which must have been enabled by e1). Not supported by serializable transactions.
+        std::vector<EdgeChange> get_edge_changes(label_t label, timestamp_t e1, timestamp_t e2);
+
+        // Parallel scans over the snapshot of this transaction, including its own writes. The vertex range is split
+        // into chunks of grain_size that TBB threads work-steal, so f is called concurrently and in no fixed order:
+        // f(vertex_id, data) for every live vertex, f(src, dst, edge_data) for every visible edge with the label.
+        // In serializable mode these scans, count_triangles, match_pattern and materialize_csr are validated at commit
+        // over every vertex, as if each adjacency list (or vertex) had been read.
+        template <typename F> void for_each_vertex(F &&f, size_t grain_size = SCAN_GRAIN_SIZE);
+        template <typename F> void for_each_edge(label_t label, F &&f, size_t grain_size = SCAN_GRAIN_SIZE);
+
+        // Samples up to k distinct visible edges of (src, label) without replacement and writes their destinations
+        // to out, returning how many were written (the degree when it is below k). Uniform by default (reservoir
+        // sampling); with a weight function each edge is drawn with probability proportional to weight(edge_data)
+        // (A-Res), edges of non-positive weight never. Nothing is allocated per call.
+        template <typename R, typename W = std::nullptr_t>
+        size_t sample_neighbors(vertex_t src, label_t label, size_t k, R &rng, vertex_t *out, W &&weight = nullptr);
+        // Batched over num_srcs sources, prefetching the blocks of the sources ahead: the sample of srcs[i] is written
+        // to out[i * k, i * k + counts[i]).
+        template <typename R, typename W = std::nullptr_t>
+        void sample_neighbors_batch(const vertex_t *srcs, size_t num_srcs, label_t label, size_t k, R &rng,
+                                    vertex_t *out, size_t *counts, W &&weight = nullptr);
+
+        // Common destinations of the label edges of src_a and src_b, ascending and without duplicates. Blocks left
+        // sorted by compaction or the batch loader (Graph::sort_edge_blocks) are merged directly; edges appended
+        // since then, or blocks never sorted, are sorted on the fly.
+        std::vector<vertex_t> intersect(vertex_t src_a, vertex_t src_b, label_t label);
+        // Triangles of the undirected graph formed by the label edges, which must be stored in both directions.
+        // Runs in parallel like the scans above; the sorted larger neighbours of every vertex are cached for the run,
+        // which takes memory in the number of edges.
+        size_t count_triangles(label_t label, size_t grain_size = SCAN_GRAIN_SIZE);
+
+        // Hop distance from root along label edges for every vertex id, NOT_REACHED if unreachable. The frontier is
+        // expanded group_size vertices at a time, interleaved: each vertex is a small state machine that prefetches
+        // the next hop of its edge_label_ptrs -> EdgeLabelBlock -> EdgeBlock chain and yields to the next vertex, so
+        // that the cache misses of the group overlap instead of stalling one after another.
+        std::vector<uint32_t> bfs(vertex_t root, label_t label, size_t group_size = INTERLEAVE_GROUP_SIZE);
+
+        // Iterators over the label edges of every srcs[i], as get_edges and get_edges_with_version return them. The
+        // edge blocks of all sources are located up front with the interleaved, prefetching lookups of bfs, so that
+        // expanding a large frontier does not wait for one chain of cache misses per vertex.
+        std::vector<EdgeIterator> get_edges_batch(const vertex_t *srcs,
+                                                  size_t num_srcs,
+                                                  label_t label,
+                                                  size_t group_size = INTERLEAVE_GROUP_SIZE);
+        std::vector<EdgeIteratorVersion> get_edges_batch(const vertex_t *srcs,
+                                                         size_t num_srcs,
+                                                         label_t label,
+                                                         timestamp_t start,
+                                                         timestamp_t end,
+                                                         size_t group_size = INTERLEAVE_GROUP_SIZE);
+
+        constexpr static uint32_t NOT_REACHED = UINT32_MAX;
+        constexpr static size_t INTERLEAVE_GROUP_SIZE = 16;
+        constexpr static size_t MAX_INTERLEAVE_GROUP_SIZE = 64;
+
+        // Calls f(binding) for every match of the pattern in this snapshot, binding[i] being the vertex bound to
+        // pattern vertex i. Generic join over sorted adjacency lists; the candidates of the first pattern vertex are
+        // split over TBB threads like the scans above, so f is called concurrently.
+        template <typename F> void match_pattern(const Pattern &pattern, F &&f, size_t grain_size = SCAN_GRAIN_SIZE);
+        size_t count_pattern(const Pattern &pattern, size_t grain_size = SCAN_GRAIN_SIZE);
+
+        // Builds an immutable CSR of the edges with the given labels (merged per source vertex, in label order) from
+        // this snapshot, in parallel. With with_properties the edge data is copied too, as a fixed-width column when
+        // all edges have the same length. An empty path keeps the CSR in memory, otherwise it is written to that file.
+        CSR materialize_csr(const std::vector<label_t> &labels, bool with_properties = false,
+                            const std::string &path = "");
+        // Same, but keeps the edges whose version lies in [start, end], as get_edges_with_version does.
+        CSR materialize_csr_with_version(const std::vector<label_t> &labels, timestamp_t start, timestamp_t end,
+                                         bool with_properties = false, const std::string &path = "");
 
         timestamp_t commit(bool wait_visable = true);
         void abort();
@@ -125,35 +311,60 @@ namespace livegraph
     private:
         Graph &graph;
         const timestamp_t local_txn_id;
+        const timestamp_t priority;
         const timestamp_t read_epoch_id;
         const bool batch_update;
         const bool trace_cache;
+        const bool serializable;
+        std::atomic<timestamp_t> &reader_slot;
         const timestamp_t write_epoch_id;
         bool valid;
-        std::string wal;
 
-        std::unordered_map<vertex_t, uintptr_t> vertex_ptr_cache;
-        std::map<std::pair<vertex_t, label_t>, uintptr_t> edge_ptr_cache;
-        std::vector<std::pair<uintptr_t, order_t>> block_cache;
-        std::unordered_map<EdgeBlockHeader *, std::pair<size_t, size_t>> edge_block_num_entries_data_length_cache;
-        std::vector<vertex_t> new_vertex_cache;
-        std::deque<vertex_t> recycled_vertex_cache;
+        // Pooled containers, owned until clean() returns them to the pool and leaves state null.
+        std::unique_ptr<TransactionState> state;
 
-        std::unordered_set<vertex_t> acquired_locks;
-        std::vector<std::pair<timestamp_t *, timestamp_t>> timestamps_to_update;
+        constexpr static size_t MAX_POOLED_STATES = 4;
+        constexpr static size_t SCAN_GRAIN_SIZE = 4096;
+        constexpr static vertex_t SCAN_PREFETCH_DISTANCE = 8;
+        constexpr static size_t OWNER_RETRY_LIMIT = 256;
+
+        static std::vector<std::unique_ptr<TransactionState>> &get_state_pool()
+        {
+            thread_local std::vector<std::unique_ptr<TransactionState>> pool;
+            return pool;
+        }
+
+        static std::unique_ptr<TransactionState> acquire_state()
+        {
+            auto &pool = get_state_pool();
+            if (pool.empty())
+                return std::make_unique<TransactionState>();
+            auto state = std::move(pool.back());
+            pool.pop_back();
+            return state;
+        }
+
+        static void release_state(std::unique_ptr<TransactionState> state)
+        {
+            auto &pool = get_state_pool();
+            if (pool.size() >= MAX_POOLED_STATES)
+                return;
+            state->clear();
+            pool.emplace_back(std::move(state));
+        }
 
         template <typename T, typename = std::enable_if_t<std::is_trivial_v<T>>> inline void wal_append(T data)
         {
-            wal.append(reinterpret_cast<char *>(&data), sizeof(T));
+            state->wal.append(reinterpret_cast<char *>(&data), sizeof(T));
         }
 
         inline void wal_append(std::string_view data)
         {
             wal_append(data.size());
-            wal.append(data);
+            state->wal.append(data);
         }
 
-        inline uint64_t &wal_num_ops() { return *reinterpret_cast<uint64_t *>(wal.data()); }
+        inline uint64_t &wal_num_ops() { return *reinterpret_cast<uint64_t *>(state->wal.data()); }
 
         void check_writable()
         {
@@ -165,6 +376,52 @@ namespace livegraph
         {
             if (!valid)
                 throw std::invalid_argument("The transaction is committed or aborted.");
+            assert(state);
+        }
+
+        // Moves the vertex indexes to the key of data, or to no key after del_vertex (data is nullptr). Called with
+        // the vertex lock held.
+        void update_vertex_indexes(vertex_t vertex_id, const std::string_view *data);
+
+        void track_changed_edges(vertex_t src, label_t label)
+        {
+            if (graph.edge_change_log)
+                state->changed_edges.emplace_back(src, label);
+        }
+
+        void log_changed_edges(timestamp_t commit_epoch_id)
+        {
+            if (state->changed_edges.empty())
+                return;
+            auto &changed_edges = state->changed_edges;
+            std::sort(changed_edges.begin(), changed_edges.end());
+            changed_edges.erase(std::unique(changed_edges.begin(), changed_edges.end()), changed_edges.end());
+            graph.edge_change_log->append(commit_epoch_id, changed_edges);
+        }
+
+        // Adds an edge just put to the version index, at commit unless this is the batch loader.
+        void track_versioned_edge(vertex_t src, label_t label, vertex_t dst, timestamp_t version);
+
+        VertexIndex &get_vertex_index(size_t index_id)
+        {
+            if (index_id >= graph.vertex_indexes.size())
+                throw std::invalid_argument("The vertex index is invalid.");
+            return *graph.vertex_indexes[index_id];
+        }
+
+        void check_key_index()
+        {
+            if (!graph.key_index.enabled())
+                throw std::invalid_argument("The key index is disabled.");
+        }
+
+        // KeyBlockHeader of key in the key index accepted by visible(key_block), or KeyIndex::NOT_FOUND
+        template <typename F> uintptr_t find_key(std::string_view key, uint64_t hash, F &&visible)
+        {
+            return graph.key_index.find(hash, [&](uintptr_t pointer) {
+                auto key_block = graph.block_manager.convert<KeyBlockHeader>(pointer);
+                return key_block->get_hash() == (uint32_t)hash && key_block->get_key() == key && visible(key_block);
+            });
         }
 
         void check_vertex_id(vertex_t vertex_id)
@@ -173,39 +430,136 @@ namespace livegraph
                 throw std::invalid_argument("The vertex id is invalid.");
         }
 
+        static std::string describe_lock(vertex_t vertex_id, label_t label)
+        {
+            if (label == ContentionProfiler::NO_LABEL)
+                return "Vertex: " + std::to_string(vertex_id);
+            return "Edge: " + std::to_string(vertex_id) + ": " + std::to_string(label);
+        }
+
+        // Wait-die: waits-for edges only point from older to younger transactions, so they cannot form a cycle.
+        // Holders without a priority (batch loader, compaction) only keep a lock for a single operation.
+        // label is ContentionProfiler::NO_LABEL for vertex locks.
+        void wait_die_lock(AdaptiveFutex &futex, timestamp_t &owner, vertex_t vertex_id, label_t label)
+        {
+            if (!futex.try_lock())
+            {
+                graph.contention_profiler.record(vertex_id, label, ContentionEvent::LockWait);
+                auto deadline = std::chrono::steady_clock::now() + Graph::LOCK_WAIT_TIMEOUT;
+                while (true)
+                {
+                    // The holder publishes its priority right after taking the futex, so an unset owner is retried
+                    // briefly before treating the holder as one without a priority.
+                    auto holder = __atomic_load_n(&owner, __ATOMIC_ACQUIRE);
+                    bool acquired = false;
+                    for (size_t i = 0; holder == Graph::NO_LOCK_OWNER && i < OWNER_RETRY_LIMIT; i++)
+                    {
+                        if ((acquired = futex.try_lock()))
+                            break;
+                        _mm_pause();
+                        holder = __atomic_load_n(&owner, __ATOMIC_ACQUIRE);
+                    }
+                    if (acquired)
+                        break;
+                    if (holder != Graph::NO_LOCK_OWNER && holder < priority)
+                    {
+                        graph.num_wait_die_rollbacks.fetch_add(1, std::memory_order_relaxed);
+                        graph.contention_profiler.record(vertex_id, label, ContentionEvent::WaitDie);
+                        throw RollbackExcept("Wait-die on " + describe_lock(vertex_id, label) + ".");
+                    }
+                    if (futex.try_lock_for(Graph::TIMEOUT))
+                        break;
+                    if (std::chrono::steady_clock::now() > deadline)
+                    {
+                        graph.num_lock_timeout_rollbacks.fetch_add(1, std::memory_order_relaxed);
+                        graph.contention_profiler.record(vertex_id, label, ContentionEvent::LockTimeout);
+                        throw RollbackExcept("Lock wait timeout on " + describe_lock(vertex_id, label) + ".");
+                    }
+                }
+            }
+            __atomic_store_n(&owner, priority, __ATOMIC_RELEASE);
+        }
+
         void ensure_vertex_lock(vertex_t vertex_id)
         {
-            auto iter = acquired_locks.find(vertex_id);
-            if (iter != acquired_locks.end())
+            auto iter = state->acquired_locks.find(vertex_id);
+            if (iter != state->acquired_locks.end())
                 return;
-            if (!graph.vertex_futexes[vertex_id].try_lock_for(Graph::TIMEOUT))
-                throw RollbackExcept("Deadlock on Vertex: " + std::to_string(vertex_id) + ".");
-            acquired_locks.emplace_hint(iter, vertex_id);
+            wait_die_lock(graph.vertex_futexes[vertex_id], graph.vertex_lock_owners[vertex_id], vertex_id,
+                          ContentionProfiler::NO_LABEL);
+            state->acquired_locks.emplace_hint(iter, vertex_id);
         }
 
-        void ensure_no_confict(vertex_t vertex_id)
+        // With fine-grained edge locking, edge blocks of (src, label) are guarded by a striped lock and the vertex
+        // lock is only needed for vertex blocks and label directory changes (see put_edge).
+        void ensure_edge_lock(vertex_t src, label_t label)
+        {
+            if (!graph.edge_futexes)
+            {
+                ensure_vertex_lock(src);
+                return;
+            }
+            auto futex_id = Graph::get_edge_futex_id(src, label);
+            auto iter = state->acquired_edge_locks.find(futex_id);
+            if (iter != state->acquired_edge_locks.end())
+                return;
+            wait_die_lock(graph.edge_futexes[futex_id], graph.edge_lock_owners[futex_id], src, label);
+            state->acquired_edge_locks.emplace_hint(iter, futex_id);
+        }
+
+        void lock_edge_for_batch(vertex_t src, label_t label)
+        {
+            if (graph.edge_futexes)
+                graph.edge_futexes[Graph::get_edge_futex_id(src, label)].lock();
+            graph.vertex_futexes[src].lock();
+        }
+
+        void unlock_edge_for_batch(vertex_t src, label_t label)
+        {
+            graph.vertex_futexes[src].unlock();
+            if (graph.edge_futexes)
+                graph.edge_futexes[Graph::get_edge_futex_id(src, label)].unlock();
+        }
+
+        bool has_confict(vertex_t vertex_id)
         {
             auto header = graph.block_manager.convert<VertexBlockHeader>(graph.vertex_ptrs[vertex_id]);
-            if (header && cmp_timestamp(header->get_creation_time_pointer(), read_epoch_id, local_txn_id) > 0)
+            return header && cmp_timestamp(header->get_creation_time_pointer(), read_epoch_id, local_txn_id) > 0;
+        }
+
+        void ensure_no_confict(vertex_t vertex_id)
+        {
+            if (has_confict(vertex_id))
+            {
+                graph.num_write_write_rollbacks.fetch_add(1, std::memory_order_relaxed);
+                graph.contention_profiler.record(vertex_id, ContentionProfiler::NO_LABEL, ContentionEvent::WriteWrite);
                 throw RollbackExcept("Write-write confict on: " + std::to_string(vertex_id) + ".");
+            }
         }
 
         void clean()
         {
-            for (const auto &vertex_id : acquired_locks)
+            for (const auto &vertex_id : state->acquired_locks)
             {
+                __atomic_store_n(&graph.vertex_lock_owners[vertex_id], Graph::NO_LOCK_OWNER, __ATOMIC_RELAXED);
                 graph.vertex_futexes[vertex_id].unlock();
             }
+            for (const auto &futex_id : state->acquired_edge_locks)
+            {
+                __atomic_store_n(&graph.edge_lock_owners[futex_id], Graph::NO_LOCK_OWNER, __ATOMIC_RELAXED);
+                graph.edge_futexes[futex_id].unlock();
+            }
             valid = false;
-            graph.read_epoch_table.local() = Graph::NO_TRANSACTION;
+            reader_slot.store(Graph::NO_TRANSACTION, std::memory_order_release);
+            release_state(std::move(state));
         }
 
         std::pair<size_t, size_t> get_num_entries_data_length_cache(EdgeBlockHeader *edge_block) const
         {
             if (batch_update || !trace_cache)
                 return edge_block->get_num_entries_data_length_atomic();
-            auto iter = edge_block_num_entries_data_length_cache.find(edge_block);
-            if (iter == edge_block_num_entries_data_length_cache.end())
+            auto iter = state->edge_block_num_entries_data_length_cache.find(edge_block);
+            if (iter == state->edge_block_num_entries_data_length_cache.end())
                 return edge_block->get_num_entries_data_length_atomic();
             else
                 return iter->second;
@@ -216,7 +570,7 @@ namespace livegraph
             if (batch_update)
                 edge_block->set_num_entries_data_length_atomic(num_entries, data_length);
             else
-                edge_block_num_entries_data_length_cache[edge_block] = {num_entries, data_length};
+                state->edge_block_num_entries_data_length_cache[edge_block] = {num_entries, data_length};
         }
 
         std::pair<EdgeEntry *, char *>
@@ -226,8 +580,496 @@ namespace livegraph
 
         uintptr_t locate_edge_block(vertex_t src, label_t label);
 
+        // Lookups for the parallel scans; they read but never fill the caches.
+        uintptr_t scan_vertex_block(vertex_t vertex_id) const
+        {
+            if (!state->vertex_ptr_cache.empty())
+            {
+                auto iter = state->vertex_ptr_cache.find(vertex_id);
+                if (iter != state->vertex_ptr_cache.end())
+                    return iter->second;
+            }
+            return graph.vertex_ptrs[vertex_id];
+        }
+
+        // Prefetches the edge block of (src, label); the label directory of src should have been prefetched before.
+        void prefetch_edge_block(vertex_t src, label_t label) const
+        {
+            auto label_block = graph.block_manager.convert<EdgeLabelBlockHeader>(graph.edge_label_ptrs[src]);
+            for (size_t i = 0; label_block && i < label_block->get_num_entries(); i++)
+            {
+                if (label_block->get_entries()[i].get_label() == label)
+                    __builtin_prefetch(
+                        graph.block_manager.convert<EdgeBlockHeader>(label_block->get_entries()[i].get_pointer()));
+            }
+        }
+
+        // Uniform integer in [0, n)
+        template <typename R> static size_t random_below(R &rng, size_t n)
+        {
+            if constexpr (R::min() == 0 && R::max() == UINT64_MAX)
+                return ((unsigned __int128)rng() * n) >> 64;
+            else
+                return std::uniform_int_distribution<size_t>(0, n - 1)(rng);
+        }
+
+        EdgeIterator scan_edge_iterator(vertex_t src, label_t label, bool reverse = false)
+        {
+            auto edge_block = graph.block_manager.convert<EdgeBlockHeader>(scan_edge_block(src, label));
+            if (!edge_block)
+                return EdgeIterator(nullptr, nullptr, 0, 0, read_epoch_id, local_txn_id, reverse);
+            auto [num_entries, data_length] = get_num_entries_data_length_cache(edge_block);
+            return EdgeIterator(edge_block->get_entries(), edge_block->get_data(), num_entries, data_length,
+                                read_epoch_id, local_txn_id, reverse);
+        }
+
+        template <typename F> void scan_edges(vertex_t src, label_t label, F &&f)
+        {
+            for (auto iter = scan_edge_iterator(src, label); iter.valid(); iter.next())
+                f(iter.dst_id(), iter.edge_data());
+        }
+
+        // Calls f(i, edge_block) with the label edge block of srcs[i] in the snapshot, once its newest entries have
+        // been prefetched; sources without one are skipped. The lookups of group_size sources are interleaved.
+        template <typename F>
+        void interleaved_locate(const vertex_t *srcs, size_t num_srcs, label_t label, size_t group_size, F &&f);
+
+        // Calls f(i, dst, edge_data) for the visible label edges of every srcs[i], group_size sources interleaved.
+        template <typename F>
+        void interleaved_scan(const vertex_t *srcs, size_t num_srcs, label_t label, size_t group_size, F &&f)
+        {
+            interleaved_locate(srcs, num_srcs, label, group_size, [&](size_t index, EdgeBlockHeader *edge_block) {
+                auto [num_entries, data_length] = get_num_entries_data_length_cache(edge_block);
+                EdgeIterator iter(edge_block->get_entries(), edge_block->get_data(), num_entries, data_length,
+                                  read_epoch_id, local_txn_id, false);
+                for (; iter.valid(); iter.next())
+                    f(index, iter.dst_id(), iter.edge_data());
+            });
+        }
+
+        // Edge blocks of every srcs[i] in the snapshot (nullptr if none), located with interleaved_locate.
+        std::vector<EdgeBlockHeader *>
+        locate_edge_blocks(const vertex_t *srcs, size_t num_srcs, label_t label, size_t group_size);
+
+        // Batch lookups follow get_edges: in serializable mode the adjacency lists read are validated at commit.
+        void track_read_edges(const vertex_t *srcs, size_t num_srcs, label_t label);
+
+        // Parallel scans cannot append to the read set from TBB threads, so they record what they cover up front.
+        void track_scanned_label(label_t label)
+        {
+            if (serializable)
+                state->scanned_labels.emplace_back(label);
+        }
+
+        void track_scanned_vertices()
+        {
+            if (serializable)
+                state->scanned_vertices = true;
+        }
+
+        // Index-driven reads have no adjacency list or vertex block to validate short of the whole graph.
+        void check_serializable_unsupported(const char *operation)
+        {
+            if (serializable)
+                throw std::invalid_argument(std::string(operation) + " is not supported by serializable transactions.");
+        }
+
+        // Destinations of a reverse (oldest first) iterator, sorted and deduplicated into out.
+        static void collect_sorted_neighbors(EdgeIterator iter, std::vector<vertex_t> &out);
+        // Sorted and deduplicated destinations of one adjacency list of a pattern plan slot.
+        void collect_pattern_slot(const PatternEdge &edge, bool reverse, vertex_t vertex, std::vector<vertex_t> &out);
+        // Sorts the edge blocks written by the batch loader, in place.
+        void sort_unsorted_edge_blocks();
+
+        EdgeIteratorVersion scan_edge_iterator_with_version(vertex_t src, label_t label, timestamp_t start,
+                                                            timestamp_t end)
+        {
+            auto edge_block = graph.block_manager.convert<EdgeBlockHeader>(scan_edge_block(src, label));
+            if (!edge_block)
+                return EdgeIteratorVersion(nullptr, nullptr, 0, 0, read_epoch_id, local_txn_id, start, end, false);
+            auto [num_entries, data_length] = get_num_entries_data_length_cache(edge_block);
+            return EdgeIteratorVersion(edge_block->get_entries(), edge_block->get_data(), num_entries, data_length,
+                                       read_epoch_id, local_txn_id, start, end, false);
+        }
+
+        template <typename F>
+        void scan_edges_with_version(vertex_t src, label_t label, timestamp_t start, timestamp_t end, F &&f)
+        {
+            for (auto iter = scan_edge_iterator_with_version(src, label, start, end); iter.valid(); iter.next())
+                f(iter.dst_id(), iter.edge_data());
+        }
+
+        uintptr_t scan_edge_block(vertex_t src, label_t label)
+        {
+            if (graph.edge_label_ptrs[src] == graph.block_manager.NULLPOINTER && state->edge_ptr_cache.empty())
+                return graph.block_manager.NULLPOINTER;
+            if (!state->edge_ptr_cache.empty())
+            {
+                auto iter = state->edge_ptr_cache.find(std::make_pair(src, label));
+                if (iter != state->edge_ptr_cache.end())
+                    return iter->second;
+            }
+            return locate_edge_block(src, label);
+        }
+
         void update_edge_label_block(vertex_t src, label_t label, uintptr_t edge_block_pointer);
 
+        // scan(vertex_id, label, f) calls f(dst, edge_data) for the edges to export.
+        template <typename S>
+        CSR build_csr(const std::vector<label_t> &labels, bool with_properties, const std::string &path, S &&scan);
+
+        bool has_confict(vertex_t src, label_t label);
         void ensure_no_confict(vertex_t src, label_t label);
+
+        // Serializable mode: locks everything in the read set and rolls back if any of it was overwritten after
+        // read_epoch_id. Run at commit; the locks are held until the commit is done.
+        void validate_read_set();
     };
+
+    template <typename F> void Transaction::for_each_vertex(F &&f, size_t grain_size)
+    {
+        check_valid();
+        track_scanned_vertices();
+        vertex_t num_vertices = graph.vertex_id.load(std::memory_order_acquire);
+        tbb::parallel_for(tbb::blocked_range<vertex_t>(0, num_vertices, grain_size), [&](const auto &range) {
+            for (vertex_t vid = range.begin(); vid < range.end(); vid++)
+            {
+                if (vid + SCAN_PREFETCH_DISTANCE < range.end())
+                {
+                    auto pointer = scan_vertex_block(vid + SCAN_PREFETCH_DISTANCE);
+                    __builtin_prefetch(graph.block_manager.convert<VertexBlockHeader>(pointer));
+                }
+
+                // Never allocated vertices have no block at all
+                auto vertex_block = graph.block_manager.convert<VertexBlockHeader>(scan_vertex_block(vid));
+                while (vertex_block &&
+                       cmp_timestamp(vertex_block->get_creation_time_pointer(), read_epoch_id, local_txn_id) > 0)
+                    vertex_block = graph.block_manager.convert<VertexBlockHeader>(vertex_block->get_prev_pointer());
+                if (!vertex_block || vertex_block->get_length() == vertex_block->TOMBSTONE)
+                    continue;
+                f(vid, std::string_view(vertex_block->get_data(), vertex_block->get_length()));
+            }
+        });
+    }
+
+    template <typename F> void Transaction::for_each_edge(label_t label, F &&f, size_t grain_size)
+    {
+        check_valid();
+        track_scanned_label(label);
+        vertex_t num_vertices = graph.vertex_id.load(std::memory_order_acquire);
+        tbb::parallel_for(tbb::blocked_range<vertex_t>(0, num_vertices, grain_size), [&](const auto &range) {
+            for (vertex_t vid = range.begin(); vid < range.end(); vid++)
+            {
+                // Two stages ahead of the cursor: the label directory, then the edge block it points to
+                if (vid + 2 * SCAN_PREFETCH_DISTANCE < range.end())
+                    __builtin_prefetch(graph.block_manager.convert<EdgeLabelBlockHeader>(
+                        graph.edge_label_ptrs[vid + 2 * SCAN_PREFETCH_DISTANCE]));
+                if (vid + SCAN_PREFETCH_DISTANCE < range.end())
+                    prefetch_edge_block(vid + SCAN_PREFETCH_DISTANCE, label);
+
+                scan_edges(vid, label, [&](vertex_t dst, std::string_view data) { f(vid, dst, data); });
+            }
+        });
+    }
+
+    template <typename F> void Transaction::match_pattern(const Pattern &pattern, F &&f, size_t grain_size)
+    {
+        check_valid();
+        const auto plan = pattern.plan();
+        const auto &edges = pattern.get_edges();
+        for (const auto &edge : edges)
+        {
+            track_scanned_label(edge.label);
+            if (edge.reverse_label != PatternEdge::NO_REVERSE_LABEL)
+                track_scanned_label(edge.reverse_label);
+        }
+        const size_t num_pattern_vertices = pattern.get_num_vertices();
+        const vertex_t num_vertices = graph.vertex_id.load(std::memory_order_acquire);
+
+        tbb::parallel_for(tbb::blocked_range<vertex_t>(0, num_vertices, grain_size), [&](const auto &range) {
+            vertex_t binding[Pattern::MAX_VERTICES];
+            std::vector<std::vector<vertex_t>> lists(plan.slots.size());
+            std::vector<std::vector<vertex_t>> candidates(num_pattern_vertices);
+
+            // Binds order[depth] to vertex; returns false if a check fails
+            auto bind = [&](size_t depth, vertex_t vertex) {
+                auto pattern_vertex = plan.order[depth];
+                if (pattern.is_injective())
+                {
+                    for (size_t i = 0; i < depth; i++)
+                    {
+                        if (binding[plan.order[i]] == vertex)
+                            return false;
+                    }
+                }
+                binding[pattern_vertex] = vertex;
+                for (auto slot : plan.fetches[depth])
+                    collect_pattern_slot(edges[plan.slots[slot].edge], plan.slots[slot].reverse, vertex, lists[slot]);
+                for (auto [slot, target] : plan.checks[depth])
+                {
+                    if (!std::binary_search(lists[slot].begin(), lists[slot].end(), binding[target]))
+                        return false;
+                }
+                return true;
+            };
+
+            auto extend = [&](size_t depth, auto &&extend) -> void {
+                if (depth == num_pattern_vertices)
+                {
+                    f((const vertex_t *)binding);
+                    return;
+                }
+                // Leapfrog over the slots, the shortest list first
+                const auto &slots = plan.extends[depth];
+                auto shortest = *std::min_element(slots.begin(), slots.end(), [&](size_t a, size_t b) {
+                    return lists[a].size() < lists[b].size();
+                });
+                auto &result = candidates[depth];
+                result = lists[shortest];
+                for (auto slot : slots)
+                {
+                    if (slot == shortest || result.empty())
+                        continue;
+                    result.resize(SortedIntersection::intersect(result.data(), result.size(), lists[slot].data(),
+                                                                lists[slot].size(), result.data()));
+                }
+                for (auto vertex : result)
+                {
+                    if (bind(depth, vertex))
+                        extend(depth + 1, extend);
+                }
+            };
+
+            for (vertex_t root = range.begin(); root < range.end(); root++)
+            {
+                if (bind(0, root))
+                    extend(1, extend);
+            }
+        });
+    }
+
+    template <typename F>
+    void Transaction::interleaved_locate(const vertex_t *srcs, size_t num_srcs, label_t label, size_t group_size, F &&f)
+    {
+        enum class Stage
+        {
+            Idle,
+            LabelPointer,
+            LabelBlock,
+            EdgeBlock,
+            Located
+        };
+        struct Coroutine
+        {
+            Stage stage = Stage::Idle;
+            size_t index;
+            vertex_t src;
+            uintptr_t pointer;
+        };
+
+        group_size = std::clamp<size_t>(group_size, 1, MAX_INTERLEAVE_GROUP_SIZE);
+        Coroutine group[MAX_INTERLEAVE_GROUP_SIZE];
+        const vertex_t num_vertices = graph.vertex_id.load(std::memory_order_acquire);
+        size_t next = 0, active = 0;
+
+        // Runs one stage of a coroutine; a stage ends with a prefetch for the next one
+        auto step = [&](Coroutine &co) {
+            switch (co.stage)
+            {
+            case Stage::Idle:
+                return;
+            case Stage::LabelPointer:
+                if (!state->edge_ptr_cache.empty())
+                {
+                    auto iter = state->edge_ptr_cache.find(std::make_pair(co.src, label));
+                    if (iter != state->edge_ptr_cache.end())
+                    {
+                        co.pointer = iter->second;
+                        co.stage = Stage::EdgeBlock;
+                        __builtin_prefetch(graph.block_manager.convert<EdgeBlockHeader>(co.pointer));
+                        return;
+                    }
+                }
+                co.pointer = graph.edge_label_ptrs[co.src];
+                co.stage = Stage::LabelBlock;
+                __builtin_prefetch(graph.block_manager.convert<EdgeLabelBlockHeader>(co.pointer));
+                return;
+            case Stage::LabelBlock:
+            {
+                auto label_block = graph.block_manager.convert<EdgeLabelBlockHeader>(co.pointer);
+                co.pointer = graph.block_manager.NULLPOINTER;
+                for (size_t i = 0; label_block && i < label_block->get_num_entries(); i++)
+                {
+                    if (label_block->get_entries()[i].get_label() == label)
+                    {
+                        co.pointer = label_block->get_entries()[i].get_pointer();
+                        break;
+                    }
+                }
+                co.stage = Stage::EdgeBlock;
+                __builtin_prefetch(graph.block_manager.convert<EdgeBlockHeader>(co.pointer));
+                return;
+            }
+            case Stage::EdgeBlock:
+            {
+                // Newer blocks than the snapshot are skipped one hop at a time
+                auto edge_block = graph.block_manager.convert<EdgeBlockHeader>(co.pointer);
+                if (edge_block && cmp_timestamp(edge_block->get_creation_time_pointer(), read_epoch_id,
+                                                local_txn_id) > 0)
+                {
+                    co.pointer = edge_block->get_prev_pointer();
+                    __builtin_prefetch(graph.block_manager.convert<EdgeBlockHeader>(co.pointer));
+                    return;
+                }
+                if (!edge_block)
+                {
+                    co.stage = Stage::Idle;
+                    active--;
+                    return;
+                }
+                auto num_entries = get_num_entries_data_length_cache(edge_block).first;
+                auto entries = edge_block->get_entries() - num_entries;
+                for (size_t i = 0; i < std::min<size_t>(num_entries, 8); i += 2)
+                    __builtin_prefetch(entries + i);
+                co.stage = Stage::Located;
+                return;
+            }
+            case Stage::Located:
+                f(co.index, graph.block_manager.convert<EdgeBlockHeader>(co.pointer));
+                co.stage = Stage::Idle;
+                active--;
+                return;
+            }
+        };
+
+        while (active || next < num_srcs)
+        {
+            for (size_t slot = 0; slot < group_size; slot++)
+            {
+                auto &co = group[slot];
+                if (co.stage == Stage::Idle)
+                {
+                    while (next < num_srcs && srcs[next] >= num_vertices)
+                        next++;
+                    if (next == num_srcs)
+                        continue;
+                    co.index = next;
+                    co.src = srcs[next++];
+                    co.stage = Stage::LabelPointer;
+                    active++;
+                    __builtin_prefetch(&graph.edge_label_ptrs[co.src]);
+                    continue;
+                }
+                step(co);
+            }
+        }
+    }
+
+    template <typename R, typename W>
+    size_t Transaction::sample_neighbors(vertex_t src, label_t label, size_t k, R &rng, vertex_t *out, W &&weight)
+    {
+        if (!k)
+            return 0;
+        auto iter = get_edges(src, label);
+        size_t count = 0;
+        if constexpr (std::is_same_v<std::decay_t<W>, std::nullptr_t>)
+        {
+            // Algorithm R: the i-th edge replaces a random slot with probability k / i
+            for (size_t i = 0; iter.valid(); iter.next(), i++)
+            {
+                if (count < k)
+                    out[count++] = iter.dst_id();
+                else if (auto slot = random_below(rng, i + 1); slot < k)
+                    out[slot] = iter.dst_id();
+            }
+        }
+        else
+        {
+            // A-Res: keep the k largest keys log(u) / w in a min-heap
+            thread_local std::vector<std::pair<double, vertex_t>> heap;
+            heap.clear();
+            std::uniform_real_distribution<double> uniform(0, 1);
+            for (; iter.valid(); iter.next())
+            {
+                double w = weight(iter.edge_data());
+                if (!(w > 0))
+                    continue;
+                double key = std::log(1 - uniform(rng)) / w;
+                if (heap.size() < k)
+                {
+                    heap.emplace_back(key, iter.dst_id());
+                    std::push_heap(heap.begin(), heap.end(), std::greater<>());
+                }
+                else if (key > heap.front().first)
+                {
+                    std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+                    heap.back() = {key, iter.dst_id()};
+                    std::push_heap(heap.begin(), heap.end(), std::greater<>());
+                }
+            }
+            for (auto [key, dst] : heap)
+                out[count++] = dst;
+        }
+        return count;
+    }
+
+    template <typename R, typename W>
+    void Transaction::sample_neighbors_batch(const vertex_t *srcs, size_t num_srcs, label_t label, size_t k, R &rng,
+                                             vertex_t *out, size_t *counts, W &&weight)
+    {
+        check_valid();
+        vertex_t num_vertices = graph.vertex_id.load(std::memory_order_acquire);
+        for (size_t i = 0; i < num_srcs; i++)
+        {
+            if (i + 2 * SCAN_PREFETCH_DISTANCE < num_srcs && srcs[i + 2 * SCAN_PREFETCH_DISTANCE] < num_vertices)
+                __builtin_prefetch(graph.block_manager.convert<EdgeLabelBlockHeader>(
+                    graph.edge_label_ptrs[srcs[i + 2 * SCAN_PREFETCH_DISTANCE]]));
+            if (i + SCAN_PREFETCH_DISTANCE < num_srcs && srcs[i + SCAN_PREFETCH_DISTANCE] < num_vertices)
+                prefetch_edge_block(srcs[i + SCAN_PREFETCH_DISTANCE], label);
+            counts[i] = sample_neighbors(srcs[i], label, k, rng, out + i * k, weight);
+        }
+    }
+
+    template <typename F> auto Graph::execute(F &&fn, const ExecuteOptions &options)
+    {
+        using result_t = std::invoke_result_t<F &, Transaction &>;
+        thread_local std::minstd_rand rng(std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+        num_executions.fetch_add(1, std::memory_order_relaxed);
+        auto backoff = options.initial_backoff;
+        timestamp_t priority = NO_TRANSACTION;
+        for (size_t retry = 0;; retry++)
+        {
+            try
+            {
+                auto txn = begin_read_write_transaction(priority, options.serializable);
+                priority = txn.get_priority();
+                if constexpr (std::is_void_v<result_t>)
+                {
+                    fn(txn);
+                    txn.commit(options.wait_visable);
+                    return;
+                }
+                else
+                {
+                    result_t result = fn(txn);
+                    txn.commit(options.wait_visable);
+                    return result;
+                }
+            }
+            catch (const Transaction::RollbackExcept &)
+            {
+                if (retry >= options.max_retries)
+                {
+                    num_execute_exhausted.fetch_add(1, std::memory_order_relaxed);
+                    throw;
+                }
+            }
+
+            num_execute_retries.fetch_add(1, std::memory_order_relaxed);
+            std::uniform_int_distribution<int64_t> jitter(0, backoff.count());
+            std::this_thread::sleep_for(std::chrono::microseconds(jitter(rng)));
+            backoff = std::min(backoff * 2, options.max_backoff);
+        }
+    }
 } // namespace livegraph
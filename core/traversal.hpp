@@ -0,0 +1,194 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "flat_hash_map.hpp"
+#include "transaction.hpp"
+#include "types.hpp"
+
+/**
+ * 在事务快照上做点对点的遍历查询，直接读取邻接表，不需要先导出 CSR。
+ */
+namespace livegraph::analytics
+{
+    struct PathOptions
+    {
+        // Label under which the application stores reversed edges (dst -> src); without it only the source side
+        // is expanded.
+        label_t reverse_label = NO_REVERSE_LABEL;
+        size_t max_hops = 6;
+        // Versions must not decrease along the path, e.g. transfers that happen one after another.
+        bool time_respecting = false;
+
+        constexpr static label_t NO_REVERSE_LABEL = std::numeric_limits<label_t>::max();
+    };
+
+    struct Path
+    {
+        std::vector<vertex_t> vertices;   // src, ..., dst; empty when not connected
+        std::vector<timestamp_t> versions; // versions[i] is the version of the edge vertices[i] -> vertices[i + 1]
+
+        bool found() const { return !vertices.empty(); }
+    };
+
+    namespace detail
+    {
+        constexpr uint32_t NO_STATE = std::numeric_limits<uint32_t>::max();
+
+        // One way of reaching a vertex. With time_respecting a vertex can be reached more than once, as long as each
+        // new state arrives strictly earlier (forward) or leaves strictly later (backward) than the previous ones.
+        struct SearchState
+        {
+            vertex_t vertex;
+            timestamp_t time;    // arrival (forward) or departure (backward) version
+            timestamp_t version; // version of the edge to the parent
+            uint32_t parent;
+            uint32_t hops;
+            uint32_t next; // previous state of the same vertex
+        };
+
+        struct SearchSide
+        {
+            std::vector<SearchState> states;
+            FlatHashMap<vertex_t, uint32_t> heads;
+            std::vector<uint32_t> frontier;
+            size_t depth = 0;
+
+            uint32_t head(vertex_t vertex) const
+            {
+                auto iter = heads.find(vertex);
+                return iter == heads.end() ? NO_STATE : iter->second;
+            }
+
+            uint32_t add(vertex_t vertex, timestamp_t time, timestamp_t version, uint32_t parent, uint32_t hops)
+            {
+                uint32_t state = states.size();
+                auto iter = heads.emplace(vertex, NO_STATE).first;
+                states.push_back(SearchState{vertex, time, version, parent, hops, iter->second});
+                iter->second = state;
+                return state;
+            }
+        };
+    } // namespace detail
+
+    // Shortest path from src to dst over label edges whose version lies in [start, end]. Bidirectional BFS that
+    // always expands the smaller frontier, stopping as soon as no shorter path can be found or max_hops is reached.
+    inline Path shortest_path(Transaction &txn,
+                              vertex_t src,
+                              vertex_t dst,
+                              label_t label,
+                              timestamp_t start,
+                              timestamp_t end,
+                              const PathOptions &options = {})
+    {
+        using namespace detail;
+
+        if (src == dst)
+            return Path{{src}, {}};
+
+        const bool bidirectional = options.reverse_label != PathOptions::NO_REVERSE_LABEL;
+        const timestamp_t earliest = std::numeric_limits<timestamp_t>::min();
+        const timestamp_t latest = std::numeric_limits<timestamp_t>::max();
+        SearchSide forward, backward;
+        forward.frontier.push_back(forward.add(src, earliest, 0, NO_STATE, 0));
+        backward.frontier.push_back(backward.add(dst, latest, 0, NO_STATE, 0));
+
+        size_t best_length = std::numeric_limits<size_t>::max();
+        uint32_t best_forward = NO_STATE, best_backward = NO_STATE;
+
+        while (!forward.frontier.empty() && !(bidirectional && backward.frontier.empty()))
+        {
+            // Every path not found yet is longer than the two explored depths together
+            auto next_length = forward.depth + backward.depth + 1;
+            if (next_length >= best_length || next_length > options.max_hops)
+                break;
+
+            const bool is_backward = bidirectional && backward.frontier.size() < forward.frontier.size();
+            auto &side = is_backward ? backward : forward;
+            auto &other = is_backward ? forward : backward;
+            std::vector<uint32_t> next_frontier;
+            std::vector<vertex_t> vertices(side.frontier.size());
+            for (size_t i = 0; i < side.frontier.size(); i++)
+                vertices[i] = side.states[side.frontier[i]].vertex;
+            auto iters = txn.get_edges_batch(vertices.data(), vertices.size(),
+                                             is_backward ? options.reverse_label : label, start, end);
+            for (size_t i = 0; i < side.frontier.size(); i++)
+            {
+                const auto state = side.frontier[i];
+                const auto current = side.states[state];
+                for (auto &iter = iters[i]; iter.valid(); iter.next())
+                {
+                    auto neighbor = iter.dst_id();
+                    auto edge_version = iter.version();
+                    auto new_time = options.time_respecting ? edge_version : 0;
+                    if (options.time_respecting &&
+                        (is_backward ? edge_version > current.time : edge_version < current.time))
+                        continue;
+
+                    // Visited, or dominated by an earlier state of the neighbor, which has no more hops
+                    auto head = side.head(neighbor);
+                    if (head != NO_STATE)
+                    {
+                        auto head_time = side.states[head].time;
+                        if (!options.time_respecting || (is_backward ? new_time <= head_time : new_time >= head_time))
+                            continue;
+                    }
+
+                    auto new_state = side.add(neighbor, new_time, edge_version, state, current.hops + 1);
+                    next_frontier.push_back(new_state);
+
+                    for (auto meet = other.head(neighbor); meet != NO_STATE; meet = other.states[meet].next)
+                    {
+                        auto length = current.hops + 1 + other.states[meet].hops;
+                        auto arrival = is_backward ? other.states[meet].time : new_time;
+                        auto departure = is_backward ? new_time : other.states[meet].time;
+                        if (arrival <= departure && length < best_length)
+                        {
+                            best_length = length;
+                            best_forward = is_backward ? meet : new_state;
+                            best_backward = is_backward ? new_state : meet;
+                        }
+                    }
+                }
+            }
+            side.frontier.swap(next_frontier);
+            side.depth++;
+        }
+
+        Path path;
+        if (best_forward == NO_STATE)
+            return path;
+        for (auto state = best_forward; state != NO_STATE; state = forward.states[state].parent)
+        {
+            path.vertices.push_back(forward.states[state].vertex);
+            if (forward.states[state].parent != NO_STATE)
+                path.versions.push_back(forward.states[state].version);
+        }
+        std::reverse(path.vertices.begin(), path.vertices.end());
+        std::reverse(path.versions.begin(), path.versions.end());
+        for (auto state = best_backward; backward.states[state].parent != NO_STATE;
+             state = backward.states[state].parent)
+        {
+            path.versions.push_back(backward.states[state].version);
+            path.vertices.push_back(backward.states[backward.states[state].parent].vertex);
+        }
+        return path;
+    }
+} // namespace livegraph::analytics
@@ -0,0 +1,150 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <tbb/concurrent_map.h>
+#include <tbb/spin_rw_mutex.h>
+
+#include "types.hpp"
+
+namespace livegraph
+{
+    struct VersionedEdge
+    {
+        vertex_t src;
+        label_t label;
+        vertex_t dst;
+        timestamp_t version;
+        std::string_view data;
+    };
+
+    // Locates an edge put with a version; its payload and visibility stay in the edge block of (src, label).
+    struct VersionIndexEntry
+    {
+        timestamp_t version;
+        vertex_t src;
+        label_t label;
+        vertex_t dst;
+
+        auto key() const { return std::tie(version, src, label, dst); }
+    };
+
+    /**
+     * 全图按边版本号（put_edge_with_version 的 version）的索引：按版本号区间分区的追加日志。
+     * 每条记录只有 (version, src, label, dst)，在事务提交时写入；查询按记录找到 (src, label) 的边块，
+     * 在快照中读取边（因此回滚、删除都能反映出来）。时间窗口查询只访问与窗口相交的分区。
+     * 压缩删除边块中已对所有读者不可见的边时，一并删除它们的记录。
+     */
+    class VersionIndex
+    {
+    public:
+        // Each partition holds the versions [k << partition_bits, (k + 1) << partition_bits).
+        explicit VersionIndex(size_t _partition_bits = DEFAULT_PARTITION_BITS)
+            : partition_bits(_partition_bits), partitions()
+        {
+        }
+
+        VersionIndex(const VersionIndex &) = delete;
+
+        void append(const VersionIndexEntry &entry)
+        {
+            auto &partition = get_partition(entry.version >> partition_bits);
+            tbb::spin_rw_mutex::scoped_lock lock(partition.mutex, true);
+            partition.entries.push_back(entry);
+        }
+
+        // Calls f(entry) for the entries with a version in [start, end], in no particular order.
+        template <typename F> void scan(timestamp_t start, timestamp_t end, F &&f)
+        {
+            if (start > end)
+                return;
+            for (auto iter = partitions.lower_bound(start >> partition_bits);
+                 iter != partitions.end() && iter->first <= (end >> partition_bits); ++iter)
+            {
+                auto &partition = *iter->second;
+                tbb::spin_rw_mutex::scoped_lock lock(partition.mutex, false);
+                for (const auto &entry : partition.entries)
+                {
+                    if (entry.version >= start && entry.version <= end)
+                        f(entry);
+                }
+            }
+        }
+
+        // Drops one entry for each of entries, which are sorted in place. A partition left empty releases its
+        // memory but keeps its node, which the concurrent map cannot erase under concurrent scans.
+        void remove(std::vector<VersionIndexEntry> &entries)
+        {
+            auto less = [](const VersionIndexEntry &a, const VersionIndexEntry &b) { return a.key() < b.key(); };
+            std::sort(entries.begin(), entries.end(), less);
+            for (auto begin = entries.begin(); begin != entries.end();)
+            {
+                auto id = begin->version >> partition_bits;
+                auto end = std::find_if(begin, entries.end(),
+                                        [&](const auto &e) { return (e.version >> partition_bits) != id; });
+                auto iter = partitions.find(id);
+                if (iter != partitions.end())
+                {
+                    auto &partition = *iter->second;
+                    std::vector<bool> removed(end - begin);
+                    tbb::spin_rw_mutex::scoped_lock lock(partition.mutex, true);
+                    auto last = std::remove_if(partition.entries.begin(), partition.entries.end(), [&](const auto &e) {
+                        for (auto match = std::lower_bound(begin, end, e, less); match != end && !less(e, *match);
+                             ++match)
+                        {
+                            if (!removed[match - begin])
+                            {
+                                removed[match - begin] = true;
+                                return true;
+                            }
+                        }
+                        return false;
+                    });
+                    partition.entries.erase(last, partition.entries.end());
+                    if (partition.entries.empty())
+                        std::vector<VersionIndexEntry>().swap(partition.entries);
+                }
+                begin = end;
+            }
+        }
+
+        constexpr static size_t DEFAULT_PARTITION_BITS = 10;
+
+    private:
+        struct Partition
+        {
+            tbb::spin_rw_mutex mutex;
+            std::vector<VersionIndexEntry> entries;
+        };
+
+        const size_t partition_bits;
+        tbb::concurrent_map<timestamp_t, std::unique_ptr<Partition>> partitions;
+
+        Partition &get_partition(timestamp_t id)
+        {
+            auto iter = partitions.find(id);
+            if (iter == partitions.end())
+                iter = partitions.emplace(id, std::make_unique<Partition>()).first;
+            return *iter->second;
+        }
+    };
+} // namespace livegraph
@@ -0,0 +1,166 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <tbb/concurrent_map.h>
+#include <tbb/concurrent_unordered_map.h>
+
+#include "allocator.hpp"
+#include "types.hpp"
+
+namespace livegraph
+{
+    // One version of "vertex has key", visible between creation_time and deletion_time like an edge entry.
+    struct VertexIndexEntry
+    {
+        VertexIndexEntry(vertex_t _vertex, timestamp_t _creation_time, timestamp_t _deletion_time,
+                         VertexIndexEntry *_prev)
+            : vertex(_vertex), creation_time(_creation_time), deletion_time(_deletion_time), prev(_prev), key()
+        {
+        }
+
+        vertex_t vertex;
+        timestamp_t creation_time;
+        timestamp_t deletion_time;
+        VertexIndexEntry *prev; // the previous entry of the same vertex
+        std::string_view key;   // the key in the index, which owns it
+    };
+
+    /**
+     * 顶点属性上的二级索引：key_of 从顶点数据中取出索引键（按字节比较）。
+     * 每次 put_vertex/del_vertex 改变键时插入一个新条目、结束旧条目的可见区间，时间戳的提交与回滚与边相同，
+     * 所以查询看到的是事务快照中的键。Hash 只支持等值查询，Ordered 还支持区间查询。
+     * 条目只增不删：被覆盖或回滚的条目留在索引中，查询时按时间戳过滤。
+     */
+    class VertexIndex
+    {
+    public:
+        enum class Type
+        {
+            Hash,
+            Ordered
+        };
+
+        // Sets key and returns true if the vertex data has the indexed property.
+        using KeyFunction = std::function<bool(std::string_view data, std::string &key)>;
+
+        VertexIndex(Type _type, KeyFunction _key_of, vertex_t _max_vertex_id)
+            : type(_type), key_of(std::move(_key_of)), max_vertex_id(_max_vertex_id), hash_entries(), ordered_entries()
+        {
+            latest_entries = SparseArrayAllocator<VertexIndexEntry *>().allocate(max_vertex_id);
+        }
+
+        VertexIndex(const VertexIndex &) = delete;
+
+        ~VertexIndex() noexcept { SparseArrayAllocator<VertexIndexEntry *>().deallocate(latest_entries, max_vertex_id); }
+
+        Type get_type() const { return type; }
+
+        bool get_key(std::string_view data, std::string &key) const { return key_of(data, key); }
+
+        // The newest entry of a vertex; only accessed under the vertex lock.
+        VertexIndexEntry *&latest_entry(vertex_t vertex) { return latest_entries[vertex]; }
+
+        VertexIndexEntry *insert(std::string key, vertex_t vertex, timestamp_t creation_time)
+        {
+            // TBB's multimaps return (iterator, true) like the unique ones
+            VertexIndexEntry *entry;
+            if (type == Type::Hash)
+            {
+                auto iter = hash_entries.emplace(std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                                                 std::forward_as_tuple(vertex, creation_time, ROLLBACK_TOMBSTONE,
+                                                                       latest_entries[vertex]))
+                                .first;
+                entry = &iter->second;
+                entry->key = iter->first;
+            }
+            else
+            {
+                auto iter = ordered_entries.emplace(std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                                                    std::forward_as_tuple(vertex, creation_time, ROLLBACK_TOMBSTONE,
+                                                                          latest_entries[vertex]))
+                                .first;
+                entry = &iter->second;
+                entry->key = iter->first;
+            }
+            latest_entries[vertex] = entry;
+            return entry;
+        }
+
+        // Calls f(entry) for the entries with key, and with Ordered for those with a key in [low, high] in key order.
+        template <typename F> void find(std::string_view key, F &&f)
+        {
+            if (type == Type::Hash)
+            {
+                auto [begin, end] = hash_entries.equal_range(std::string(key));
+                for (auto iter = begin; iter != end; ++iter)
+                    f(iter->second);
+            }
+            else
+            {
+                find(key, key, f);
+            }
+        }
+
+        template <typename F> void find(std::string_view low, std::string_view high, F &&f)
+        {
+            if (type != Type::Ordered)
+                throw std::invalid_argument("Range lookups need an ordered index.");
+            for (auto iter = ordered_entries.lower_bound(std::string(low));
+                 iter != ordered_entries.end() && std::string_view(iter->first) <= high; ++iter)
+                f(iter->second);
+        }
+
+        // Keys whose byte order is the numeric order, for ordered indexes over numbers.
+        template <typename T> static std::string encode(T value)
+        {
+            static_assert(std::is_arithmetic_v<T>);
+            using U = std::conditional_t<sizeof(T) == 8, uint64_t,
+                                         std::conditional_t<sizeof(T) == 4, uint32_t,
+                                                            std::conditional_t<sizeof(T) == 2, uint16_t, uint8_t>>>;
+            constexpr U sign = U(1) << (sizeof(U) * 8 - 1);
+            U bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            if constexpr (std::is_floating_point_v<T>)
+                bits = (bits & sign) ? ~bits : bits | sign;
+            else if constexpr (std::is_signed_v<T>)
+                bits ^= sign;
+            std::string key(sizeof(U), 0);
+            for (size_t i = 0; i < sizeof(U); i++)
+                key[i] = (char)(bits >> ((sizeof(U) - 1 - i) * 8));
+            return key;
+        }
+
+    private:
+        const Type type;
+        const KeyFunction key_of;
+        const vertex_t max_vertex_id;
+        VertexIndexEntry **latest_entries;
+        tbb::concurrent_unordered_multimap<std::string, VertexIndexEntry> hash_entries;
+        tbb::concurrent_multimap<std::string, VertexIndexEntry> ordered_entries;
+
+        constexpr static timestamp_t ROLLBACK_TOMBSTONE = INT64_MAX;
+    };
+} // namespace livegraph
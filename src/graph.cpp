@@ -13,47 +13,234 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
 #include "core/graph.hpp"
 #include "core/transaction.hpp"
 
 using namespace livegraph;
 
-Transaction Graph::begin_transaction()
+std::atomic<timestamp_t> &Graph::get_reader_slot()
+{
+    thread_local const ReaderRegistry *cached_registry = nullptr;
+    thread_local std::atomic<timestamp_t> *cached_slot = nullptr;
+    if (cached_registry == reader_registry.get())
+        return *cached_slot;
+
+    // One handle per graph used by this thread; handles of destroyed graphs are dropped here.
+    // A cached registry stays alive as long as its handle, so its address cannot be reused by another graph.
+    thread_local std::vector<ReaderHandle> handles;
+    handles.erase(std::remove_if(handles.begin(), handles.end(), [](const auto &h) { return h.is_orphan(); }),
+                  handles.end());
+    auto iter = std::find_if(handles.begin(), handles.end(),
+                             [&](const auto &h) { return h.get_registry() == reader_registry.get(); });
+    if (iter == handles.end())
+    {
+        handles.emplace_back(reader_registry);
+        iter = handles.end() - 1;
+    }
+    cached_registry = reader_registry.get();
+    cached_slot = &iter->get_read_epoch_id();
+    return *cached_slot;
+}
+
+Transaction Graph::begin_transaction(timestamp_t priority) { return begin_read_write_transaction(priority, false); }
+
+Transaction Graph::begin_serializable_transaction(timestamp_t priority)
+{
+    return begin_read_write_transaction(priority, true);
+}
+
+Transaction Graph::begin_read_write_transaction(timestamp_t priority, bool serializable)
 {
     auto local_txn_id = transaction_id.fetch_add(1, std::memory_order_relaxed) + 1; // txn_id begin from 1
     auto read_epoch_id = epoch_id.load(std::memory_order_acquire);
-    read_epoch_table.local() = read_epoch_id;
+    auto &reader_slot = get_reader_slot();
+    reader_slot.store(read_epoch_id, std::memory_order_release);
     if (local_txn_id % COMPACTION_CYCLE == 0)
         compact(local_txn_id);
-    return Transaction(*this, local_txn_id, read_epoch_id, false, true);
+    if (priority == NO_TRANSACTION)
+        priority = local_txn_id;
+    return Transaction(*this, local_txn_id, read_epoch_id, false, true, reader_slot, priority, serializable);
 }
 
 Transaction Graph::begin_read_only_transaction()
 {
     auto read_epoch_id = epoch_id.load(std::memory_order_acquire);
-    read_epoch_table.local() = read_epoch_id;
-    return Transaction(*this, RO_TRANSACTION, read_epoch_id, false, false);
+    auto &reader_slot = get_reader_slot();
+    reader_slot.store(read_epoch_id, std::memory_order_release);
+    return Transaction(*this, RO_TRANSACTION, read_epoch_id, false, false, reader_slot);
 }
 
 Transaction Graph::begin_batch_loader()
 {
     auto read_epoch_id = epoch_id.load(std::memory_order_acquire);
-    read_epoch_table.local() = read_epoch_id;
-    return Transaction(*this, RO_TRANSACTION, read_epoch_id, true, false);
+    auto &reader_slot = get_reader_slot();
+    reader_slot.store(read_epoch_id, std::memory_order_release);
+    return Transaction(*this, RO_TRANSACTION, read_epoch_id, true, false, reader_slot);
+}
+
+vertex_t Graph::allocate_vertex_id(bool use_recycled_vertex)
+{
+    vertex_t vid;
+    if (vertex_id_batch_size <= 1)
+    {
+        if (!use_recycled_vertex || !recycled_vertex_ids.try_pop(vid))
+            vid = vertex_id.fetch_add(1, std::memory_order_relaxed);
+        clear_vertex_slots(vid);
+        return vid;
+    }
+
+    auto &cache = vertex_id_caches.local();
+    if (use_recycled_vertex)
+    {
+        if (cache.recycled.empty())
+            recycled_vertex_id_batches.try_pop(cache.recycled);
+        if (!cache.recycled.empty())
+        {
+            vid = cache.recycled.back();
+            cache.recycled.pop_back();
+            clear_vertex_slots(vid);
+            return vid;
+        }
+    }
+
+    // Slots of never used ids are still zero from the sparse array allocator, which is the cleared state.
+    if (cache.next == cache.end)
+    {
+        cache.next = vertex_id.fetch_add(vertex_id_batch_size, std::memory_order_relaxed);
+        cache.end = std::min(cache.next + vertex_id_batch_size, max_vertex_id);
+        if (cache.next >= cache.end)
+            throw std::runtime_error("Vertex id overflow.");
+    }
+    return cache.next++;
+}
+
+void Graph::recycle_vertex_id(vertex_t vid)
+{
+    if (vertex_id_batch_size <= 1)
+    {
+        recycled_vertex_ids.push(vid);
+        return;
+    }
+
+    auto &cache = vertex_id_caches.local();
+    cache.recycled.push_back(vid);
+    if (cache.recycled.size() >= 2 * vertex_id_batch_size)
+    {
+        std::vector<vertex_t> batch(cache.recycled.begin(), cache.recycled.begin() + vertex_id_batch_size);
+        cache.recycled.erase(cache.recycled.begin(), cache.recycled.begin() + vertex_id_batch_size);
+        recycled_vertex_id_batches.push(std::move(batch));
+    }
+}
+
+size_t Graph::create_vertex_index(VertexIndex::Type type, VertexIndex::KeyFunction key_of)
+{
+    auto index = std::make_unique<VertexIndex>(type, std::move(key_of), max_vertex_id);
+    std::string key;
+    for (vertex_t vid = 0; vid < vertex_id.load(std::memory_order_acquire); vid++)
+    {
+        auto vertex_block = block_manager.convert<VertexBlockHeader>(vertex_ptrs[vid]);
+        if (!vertex_block || vertex_block->get_length() == vertex_block->TOMBSTONE)
+            continue;
+        if (index->get_key(std::string_view(vertex_block->get_data(), vertex_block->get_length()), key))
+            index->insert(key, vid, vertex_block->get_creation_time());
+    }
+    vertex_indexes.emplace_back(std::move(index));
+    return vertex_indexes.size() - 1;
+}
+
+void Graph::retire_key_block(uintptr_t pointer)
+{
+    auto key_block = block_manager.convert<KeyBlockHeader>(pointer);
+    key_index.remove(KeyIndex::hash(key_block->get_key()), pointer);
+    auto vertex_id = key_block->get_vertex_id();
+    if (vertex_key_ptrs[vertex_id] == pointer)
+        vertex_key_ptrs[vertex_id] = block_manager.NULLPOINTER;
+    retired_key_blocks.local().emplace_back(pointer, epoch_id.load());
+}
+
+void Graph::free_key_block(uintptr_t pointer)
+{
+    auto key_block = block_manager.convert<KeyBlockHeader>(pointer);
+    key_block->set_type(BlockHeader::Type::FREE);
+    block_manager.free(pointer, key_block->get_order());
+}
+
+void Graph::recover_key_index()
+{
+    if (!key_index.enabled())
+        throw std::invalid_argument("The key index is disabled.");
+    key_index.clear();
+    std::fill(vertex_key_ptrs, vertex_key_ptrs + vertex_id.load(), block_manager.NULLPOINTER);
+    for (auto pointer = block_manager.get_first_block(); pointer < block_manager.get_end_block();)
+    {
+        auto header = block_manager.convert<BlockHeader>(pointer);
+        if (header->get_order() == 0)
+            throw std::runtime_error("Unfilled block in the block region.");
+        if (header->get_type() == BlockHeader::Type::KEY)
+        {
+            auto key_block = block_manager.convert<KeyBlockHeader>(pointer);
+            auto creation_time = *key_block->get_creation_time_pointer();
+            // 未提交（负数）和回滚的插入都不恢复
+            if (creation_time >= 0 && creation_time != ROLLBACK_TOMBSTONE)
+            {
+                key_index.insert(KeyIndex::hash(key_block->get_key()), pointer, [](uintptr_t) { return false; });
+                vertex_key_ptrs[key_block->get_vertex_id()] = pointer;
+            }
+        }
+        pointer += header->get_block_size();
+    }
+}
+
+void Graph::create_version_index(size_t partition_bits)
+{
+    if (version_index)
+        throw std::runtime_error("The version index already exists.");
+    auto index = std::make_unique<VersionIndex>(partition_bits);
+    for (vertex_t vid = 0; vid < vertex_id.load(std::memory_order_acquire); vid++)
+    {
+        auto label_block = block_manager.convert<EdgeLabelBlockHeader>(edge_label_ptrs[vid]);
+        if (!label_block)
+            continue;
+        for (size_t i = 0; i < label_block->get_num_entries(); i++)
+        {
+            auto label = label_block->get_entries()[i].get_label();
+            auto edge_block = block_manager.convert<EdgeBlockHeader>(label_block->get_entries()[i].get_pointer());
+            if (!edge_block)
+                continue;
+            auto [num_entries, data_length] = edge_block->get_num_entries_data_length_atomic();
+            auto entries = edge_block->get_entries();
+            for (size_t j = 0; j < num_entries; j++)
+            {
+                entries--;
+                if (entries->get_creation_time() != ROLLBACK_TOMBSTONE)
+                    index->append({entries->get_version(), vid, label, entries->get_dst()});
+            }
+        }
+    }
+    version_index = std::move(index);
+}
+
+void Graph::enable_edge_change_log()
+{
+    if (edge_change_log)
+        throw std::runtime_error("The edge change log is already enabled.");
+    edge_change_log = std::make_unique<EdgeChangeLog>(epoch_id.load());
 }
 
 timestamp_t Graph::compact(timestamp_t read_epoch_id)
 {
     if (read_epoch_id == NO_TRANSACTION)
         read_epoch_id = epoch_id.load();
-    for (auto id : read_epoch_table)
-    {
+    reader_registry->for_each([&](timestamp_t id) {
         if (id != NO_TRANSACTION && id < read_epoch_id)
             read_epoch_id = id;
-    }
+    });
 
     size_t recycled_block_size = 0;
     std::unordered_set<vertex_t> new_compact_table;
+    std::vector<VersionIndexEntry> dead_versioned_edges;
 
     for (vertex_t vid : compact_table.local())
     {
@@ -121,6 +308,15 @@ timestamp_t Graph::compact(timestamp_t read_epoch_id)
                     auto edge_block = block_manager.convert<EdgeBlockHeader>(pointer);
                     if (!edge_block)
                         continue;
+
+                    AdaptiveFutex *edge_futex =
+                        edge_futexes ? &edge_futexes[get_edge_futex_id(vid, label_entry.get_label())] : nullptr;
+                    if (edge_futex && !edge_futex->try_lock_for(TIMEOUT))
+                    {
+                        need_future_compact = true;
+                        continue;
+                    }
+
                     compact_n2o_blocks(pointer);
 
                     size_t new_num_entries = 0;
@@ -138,11 +334,22 @@ timestamp_t Graph::compact(timestamp_t read_epoch_id)
                             new_num_entries++;
                             new_data_length += entries->get_length();
                         }
+                        else if (version_index)
+                        {
+                            dead_versioned_edges.push_back(
+                                {entries->get_version(), vid, label_entry.get_label(), entries->get_dst()});
+                        }
                     }
                     entries = edge_block->get_entries(); // Reset cursor
 
-                    if (new_num_entries == num_entries)
+                    bool need_sort = sort_edge_blocks &&
+                                     num_entries - edge_block->get_num_sorted_entries(num_entries) > max_unsorted_tail;
+                    if (new_num_entries == num_entries && !need_sort)
+                    {
+                        if (edge_futex)
+                            edge_futex->unlock();
                         continue;
+                    }
 
                     // Copy a new edge block
                     need_future_compact = true;
@@ -163,16 +370,27 @@ timestamp_t Graph::compact(timestamp_t read_epoch_id)
                     auto new_edge_block = block_manager.convert<EdgeBlockHeader>(new_pointer);
                     new_edge_block->fill(order, vid, read_epoch_id, pointer, edge_block->get_committed_time());
 
-                    auto bloom_filter = new_edge_block->get_bloom_filter();
-                    for (size_t i = 0; i < num_entries; i++)
+                    if (sort_edge_blocks)
                     {
-                        entries--;
-                        if (cmp_timestamp(entries->get_deletion_time_pointer(), read_epoch_id) > 0)
-                            new_edge_block->append(*entries, data, bloom_filter);
-                        data += entries->get_length();
+                        new_edge_block->append_sorted(edge_block, num_entries, [&](EdgeEntry &entry) {
+                            return cmp_timestamp(entry.get_deletion_time_pointer(), read_epoch_id) > 0;
+                        });
+                    }
+                    else
+                    {
+                        auto bloom_filter = new_edge_block->get_bloom_filter();
+                        for (size_t i = 0; i < num_entries; i++)
+                        {
+                            entries--;
+                            if (cmp_timestamp(entries->get_deletion_time_pointer(), read_epoch_id) > 0)
+                                new_edge_block->append(*entries, data, bloom_filter);
+                            data += entries->get_length();
+                        }
                     }
 
                     label_entry.set_pointer(new_pointer);
+                    if (edge_futex)
+                        edge_futex->unlock();
 
                     // printf("Compact %lu edges, %lu data\n",
                     // num_entries-new_num_entries,
@@ -188,6 +406,26 @@ timestamp_t Graph::compact(timestamp_t read_epoch_id)
 
     compact_table.local().swap(new_compact_table);
 
+    if (!dead_versioned_edges.empty())
+        version_index->remove(dead_versioned_edges);
+
+    // Key blocks unpublished before every reader began
+    auto &retired = retired_key_blocks.local();
+    size_t num_retired = 0;
+    for (auto [pointer, epoch] : retired)
+    {
+        if (epoch < read_epoch_id)
+        {
+            recycled_block_size += block_manager.convert<KeyBlockHeader>(pointer)->get_block_size();
+            free_key_block(pointer);
+        }
+        else
+        {
+            retired[num_retired++] = {pointer, epoch};
+        }
+    }
+    retired.resize(num_retired);
+
     // printf("Compact %lu bytes blocks\n", recycled_block_size);
 
     return read_epoch_id;
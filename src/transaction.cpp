@@ -13,6 +13,18 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <tuple>
+
+#include <tbb/combinable.h>
+#include <tbb/parallel_reduce.h>
+
 #include "core/transaction.hpp"
 #include "core/edge_iterator.hpp"
 #include "core/graph.hpp"
@@ -32,26 +44,22 @@ vertex_t Transaction::new_vertex(bool use_recycled_vertex)
     vertex_t vertex_id;
 
     // 如果不是批量更新事务且回收顶点 ID 缓存不为空，则从中取出一个顶点 ID。
-    if (!batch_update && recycled_vertex_cache.size())
+    if (!batch_update && state->recycled_vertex_cache.size())
     {
-        vertex_id = recycled_vertex_cache.front();
-        recycled_vertex_cache.pop_front();
+        vertex_id = state->recycled_vertex_cache.front();
+        state->recycled_vertex_cache.pop_front();
+        graph.clear_vertex_slots(vertex_id);
     }
-    // 如果不使用回收的顶点 ID 或者无法获取到，则分配一个新的顶点 ID。
-    else if (!use_recycled_vertex || (!graph.recycled_vertex_ids.try_pop(vertex_id)))
+    // 否则从回收的顶点 ID 或新的顶点 ID 中分配，槽位由 allocate_vertex_id 清空。
+    else
     {
-        vertex_id = graph.vertex_id.fetch_add(1, std::memory_order_relaxed);
+        vertex_id = graph.allocate_vertex_id(use_recycled_vertex);
     }
 
-    // 对顶点加锁、设置顶点指针和边标签指针为空。
-    graph.vertex_futexes[vertex_id].clear();
-    graph.vertex_ptrs[vertex_id] = graph.block_manager.NULLPOINTER;
-    graph.edge_label_ptrs[vertex_id] = graph.block_manager.NULLPOINTER;
-
     // 如果不是批量更新事务，则将新顶点 ID 加入缓存中，并记录 WAL 日志。
     if (!batch_update)
     {
-        new_vertex_cache.emplace_back(vertex_id);
+        state->new_vertex_cache.emplace_back(vertex_id);
         ++wal_num_ops();
         wal_append(OPType::NewVertex);
         wal_append(vertex_id);
@@ -95,10 +103,10 @@ void Transaction::put_vertex(vertex_t vertex_id, std::string_view data)
         ensure_vertex_lock(vertex_id);
         
         // 在缓存中查找该顶点的指针
-        auto cache_iter = vertex_ptr_cache.find(vertex_id);
+        auto cache_iter = state->vertex_ptr_cache.find(vertex_id);
         
         // 如果找到了，则使用之前缓存的指针
-        if (cache_iter != vertex_ptr_cache.end()) {
+        if (cache_iter != state->vertex_ptr_cache.end()) {
             // std::cout << "from cache" << std::endl;
             prev_pointer = cache_iter->second;
         }
@@ -129,6 +137,8 @@ void Transaction::put_vertex(vertex_t vertex_id, std::string_view data)
     // 将该顶点标记为已更新状态
     graph.compact_table.local().emplace(vertex_id);
     
+    update_vertex_indexes(vertex_id, &data);
+
     // 如果是批量更新，则直接更新图中顶点的指针
     if (batch_update)
     {
@@ -138,9 +148,9 @@ void Transaction::put_vertex(vertex_t vertex_id, std::string_view data)
     else
     {
         // 否则将更新缓存、块缓存和wal日志
-        block_cache.emplace_back(pointer, order);
-        timestamps_to_update.emplace_back(vertex_block->get_creation_time_pointer(), Graph::ROLLBACK_TOMBSTONE);
-        vertex_ptr_cache[vertex_id] = pointer;
+        state->block_cache.emplace_back(pointer, order);
+        state->timestamps_to_update.emplace_back(vertex_block->get_creation_time_pointer(), Graph::ROLLBACK_TOMBSTONE);
+        state->vertex_ptr_cache[vertex_id] = pointer;
         ++wal_num_ops();
         wal_append(OPType::PutVertex);
         wal_append(vertex_id);
@@ -148,6 +158,102 @@ void Transaction::put_vertex(vertex_t vertex_id, std::string_view data)
     }
 }
 
+std::pair<vertex_t, bool> Transaction::find_or_create_vertex(std::string_view key, bool use_recycled_vertex)
+{
+    check_valid();
+    check_writable();
+    check_key_index();
+
+    // 回滚的插入留下的键被跳过；其他版本要么可见，要么是写写冲突
+    auto hash = KeyIndex::hash(key);
+    auto is_live = [](KeyBlockHeader *key_block) {
+        return *key_block->get_creation_time_pointer() != Graph::ROLLBACK_TOMBSTONE;
+    };
+    auto pointer = find_key(key, hash, is_live);
+    if (pointer == KeyIndex::NOT_FOUND)
+    {
+        auto vertex_id = new_vertex(use_recycled_vertex);
+        auto order = size_to_order(sizeof(KeyBlockHeader) + key.size());
+        auto new_pointer = graph.block_manager.alloc(order);
+        auto key_block = graph.block_manager.convert<KeyBlockHeader>(new_pointer);
+        key_block->fill(order, vertex_id, write_epoch_id, hash, key);
+
+        try
+        {
+            // 回滚的插入在 abort 中才变为墓碑，在那之前跳过
+            pointer = graph.key_index.insert(hash, new_pointer, [&](uintptr_t other) {
+                auto other_block = graph.block_manager.convert<KeyBlockHeader>(other);
+                return other_block->get_hash() == (uint32_t)hash && other_block->get_key() == key &&
+                       is_live(other_block);
+            });
+        }
+        catch (...)
+        {
+            // The table is full; the new vertex of a read-write transaction is recycled when it rolls back
+            graph.free_key_block(new_pointer);
+            if (batch_update)
+                graph.recycle_vertex_id(vertex_id);
+            throw;
+        }
+        if (pointer == new_pointer)
+        {
+            graph.vertex_key_ptrs[vertex_id] = new_pointer;
+            if (!batch_update)
+            {
+                state->timestamps_to_update.emplace_back(key_block->get_creation_time_pointer(),
+                                                         Graph::ROLLBACK_TOMBSTONE);
+                state->new_key_blocks.emplace_back(new_pointer);
+                ++wal_num_ops();
+                wal_append(OPType::PutKey);
+                wal_append(vertex_id);
+                wal_append(key);
+            }
+            return {vertex_id, true};
+        }
+
+        // 另一个事务同时插入了这个键；读写事务的新顶点在回滚时回收
+        graph.free_key_block(new_pointer);
+        if (batch_update)
+            graph.recycle_vertex_id(vertex_id);
+    }
+
+    auto key_block = graph.block_manager.convert<KeyBlockHeader>(pointer);
+    if (cmp_timestamp(key_block->get_creation_time_pointer(), read_epoch_id, local_txn_id) > 0)
+    {
+        graph.num_write_write_rollbacks.fetch_add(1, std::memory_order_relaxed);
+        throw RollbackExcept("Write-write confict on the key: " + std::string(key) + ".");
+    }
+    return {key_block->get_vertex_id(), false};
+}
+
+vertex_t Transaction::find_vertex(std::string_view key)
+{
+    check_valid();
+    check_key_index();
+
+    auto pointer = find_key(key, KeyIndex::hash(key), [&](KeyBlockHeader *key_block) {
+        return cmp_timestamp(key_block->get_creation_time_pointer(), read_epoch_id, local_txn_id) <= 0;
+    });
+    if (pointer == KeyIndex::NOT_FOUND)
+        return NO_VERTEX;
+    return graph.block_manager.convert<KeyBlockHeader>(pointer)->get_vertex_id();
+}
+
+std::string_view Transaction::get_vertex_key(vertex_t vertex_id)
+{
+    check_valid();
+    check_key_index();
+
+    if (vertex_id >= graph.vertex_id.load(std::memory_order_relaxed))
+        return std::string_view();
+    auto key_block = graph.block_manager.convert<KeyBlockHeader>(graph.vertex_key_ptrs[vertex_id]);
+    // The slot may still point to the key of an aborted vertex whose id was recycled
+    if (!key_block || key_block->get_vertex_id() != vertex_id ||
+        cmp_timestamp(key_block->get_creation_time_pointer(), read_epoch_id, local_txn_id) > 0)
+        return std::string_view();
+    return key_block->get_key();
+}
+
 bool Transaction::del_vertex(vertex_t vertex_id, bool recycle)
 {
     check_valid();
@@ -163,8 +269,8 @@ bool Transaction::del_vertex(vertex_t vertex_id, bool recycle)
     else
     {
         ensure_vertex_lock(vertex_id);
-        auto cache_iter = vertex_ptr_cache.find(vertex_id);
-        if (cache_iter != vertex_ptr_cache.end())
+        auto cache_iter = state->vertex_ptr_cache.find(vertex_id);
+        if (cache_iter != state->vertex_ptr_cache.end())
             prev_pointer = cache_iter->second;
         else
         {
@@ -189,16 +295,18 @@ bool Transaction::del_vertex(vertex_t vertex_id, bool recycle)
 
         if (!batch_update)
         {
-            block_cache.emplace_back(pointer, order);
-            timestamps_to_update.emplace_back(vertex_block->get_creation_time_pointer(), Graph::ROLLBACK_TOMBSTONE);
-            vertex_ptr_cache[vertex_id] = pointer;
+            state->block_cache.emplace_back(pointer, order);
+            state->timestamps_to_update.emplace_back(vertex_block->get_creation_time_pointer(),
+                                                     Graph::ROLLBACK_TOMBSTONE);
+            state->vertex_ptr_cache[vertex_id] = pointer;
         }
+        update_vertex_indexes(vertex_id, nullptr);
     }
 
     if (batch_update)
     {
         if (recycle)
-            graph.recycled_vertex_ids.push(vertex_id);
+            graph.recycle_vertex_id(vertex_id);
         graph.vertex_futexes[vertex_id].unlock();
     }
     else
@@ -209,12 +317,68 @@ bool Transaction::del_vertex(vertex_t vertex_id, bool recycle)
         wal_append(recycle);
 
         if (recycle)
-            recycled_vertex_cache.emplace_back(vertex_id);
+            state->recycled_vertex_cache.emplace_back(vertex_id);
     }
 
     return ret;
 }
 
+void Transaction::update_vertex_indexes(vertex_t vertex_id, const std::string_view *data)
+{
+    std::string key;
+    for (auto &index : graph.vertex_indexes)
+    {
+        // 跳过被回滚的条目；最新条目未结束时就是顶点当前的键
+        auto latest = index->latest_entry(vertex_id);
+        while (latest && latest->creation_time == Graph::ROLLBACK_TOMBSTONE)
+            latest = latest->prev;
+        if (latest && latest->deletion_time != Graph::ROLLBACK_TOMBSTONE)
+            latest = nullptr;
+
+        bool has_key = data && index->get_key(*data, key);
+        if (latest && has_key && latest->key == key)
+            continue;
+        if (latest)
+        {
+            if (!batch_update)
+                state->timestamps_to_update.emplace_back(&latest->deletion_time, latest->deletion_time);
+            latest->deletion_time = write_epoch_id;
+        }
+        if (has_key)
+        {
+            auto entry = index->insert(key, vertex_id, write_epoch_id);
+            if (!batch_update)
+                state->timestamps_to_update.emplace_back(&entry->creation_time, Graph::ROLLBACK_TOMBSTONE);
+        }
+    }
+}
+
+std::vector<vertex_t> Transaction::find_vertices(size_t index_id, std::string_view key)
+{
+    check_valid();
+    check_serializable_unsupported("find_vertices");
+    std::vector<vertex_t> vertices;
+    get_vertex_index(index_id).find(key, [&](VertexIndexEntry &entry) {
+        if (cmp_timestamp(&entry.creation_time, read_epoch_id, local_txn_id) <= 0 &&
+            cmp_timestamp(&entry.deletion_time, read_epoch_id, local_txn_id) > 0)
+            vertices.push_back(entry.vertex);
+    });
+    return vertices;
+}
+
+std::vector<vertex_t> Transaction::find_vertices(size_t index_id, std::string_view low, std::string_view high)
+{
+    check_valid();
+    check_serializable_unsupported("find_vertices");
+    std::vector<vertex_t> vertices;
+    get_vertex_index(index_id).find(low, high, [&](VertexIndexEntry &entry) {
+        if (cmp_timestamp(&entry.creation_time, read_epoch_id, local_txn_id) <= 0 &&
+            cmp_timestamp(&entry.deletion_time, read_epoch_id, local_txn_id) > 0)
+            vertices.push_back(entry.vertex);
+    });
+    return vertices;
+}
+
 std::string_view Transaction::get_vertex(vertex_t vertex_id)
 {
     check_valid();
@@ -229,11 +393,17 @@ std::string_view Transaction::get_vertex(vertex_t vertex_id)
     }
     else
     {
-        auto cache_iter = vertex_ptr_cache.find(vertex_id);
-        if (cache_iter != vertex_ptr_cache.end())
+        auto cache_iter = state->vertex_ptr_cache.find(vertex_id);
+        if (cache_iter != state->vertex_ptr_cache.end())
+        {
             pointer = cache_iter->second;
+        }
         else
+        {
             pointer = graph.vertex_ptrs[vertex_id];
+            if (serializable)
+                state->read_vertices.emplace_back(vertex_id);
+        }
     }
 
     auto vertex_block = graph.block_manager.convert<VertexBlockHeader>(pointer);
@@ -341,12 +511,12 @@ uintptr_t Transaction::locate_edge_block(vertex_t src, label_t label)
 
 
 // 保护多个事务同时访问图中的同一条边，以避免写入冲突。它是一个关键的保障措施，以确保系统的数据一致性和正确性。
-void Transaction::ensure_no_confict(vertex_t src, label_t label)
+bool Transaction::has_confict(vertex_t src, label_t label)
 {
     // 从图中获取指向src的edge_label_ptr，并检查它是否为 NULLPOINTER。如果是，函数将立即返回，因为没有与该源节点相关的edge_label_block。
     auto pointer = graph.edge_label_ptrs[src];
     if (pointer == graph.block_manager.NULLPOINTER)
-        return;
+        return false;
     // 如果存在edge_label_block，则函数遍历其条目并查找与给定标签匹配的条目。
     auto edge_label_block = graph.block_manager.convert<EdgeLabelBlockHeader>(pointer);
     for (size_t i = 0; i < edge_label_block->get_num_entries(); i++)
@@ -361,12 +531,73 @@ void Transaction::ensure_no_confict(vertex_t src, label_t label)
                 auto header = graph.block_manager.convert<EdgeBlockHeader>(pointer);
                 // 如果不是，则获取该指针所指向的边缘块的头信息，并比较其提交时间戳与当前事务的时间戳，以确定是否存在写入冲突。
                 if (header && cmp_timestamp(header->get_committed_time_pointer(), read_epoch_id, local_txn_id) > 0)
-                // 如果存在写入冲突，则函数抛出 RollbackExcept 异常，指示发生了写入-写入冲突
-                    throw RollbackExcept("Write-write confict on: " + std::to_string(src) + ": " +
-                                         std::to_string(label) + ".");
+                    return true;
             }
-            return;
+            return false;
+        }
+    }
+    return false;
+}
+
+void Transaction::ensure_no_confict(vertex_t src, label_t label)
+{
+    if (has_confict(src, label))
+    {
+        // 如果存在写入冲突，则函数抛出 RollbackExcept 异常，指示发生了写入-写入冲突
+        graph.num_write_write_rollbacks.fetch_add(1, std::memory_order_relaxed);
+        graph.contention_profiler.record(src, label, ContentionEvent::WriteWrite);
+        throw RollbackExcept("Write-write confict on: " + std::to_string(src) + ": " + std::to_string(label) + ".");
+    }
+}
+
+void Transaction::validate_read_set()
+{
+    // 对读集合上锁后，检查读到的版本在提交前没有被其他事务覆盖
+    auto validate_vertex = [&](vertex_t vertex_id) {
+        ensure_vertex_lock(vertex_id);
+        if (has_confict(vertex_id))
+        {
+            graph.num_read_write_rollbacks.fetch_add(1, std::memory_order_relaxed);
+            graph.contention_profiler.record(vertex_id, ContentionProfiler::NO_LABEL, ContentionEvent::ReadWrite);
+            throw RollbackExcept("Read-write confict on: " + std::to_string(vertex_id) + ".");
         }
+    };
+    auto validate_edges = [&](vertex_t src, label_t label) {
+        ensure_edge_lock(src, label);
+        if (has_confict(src, label))
+        {
+            graph.num_read_write_rollbacks.fetch_add(1, std::memory_order_relaxed);
+            graph.contention_profiler.record(src, label, ContentionEvent::ReadWrite);
+            throw RollbackExcept("Read-write confict on: " + std::to_string(src) + ": " + std::to_string(label) +
+                                 ".");
+        }
+    };
+
+    auto &read_vertices = state->read_vertices;
+    std::sort(read_vertices.begin(), read_vertices.end());
+    read_vertices.erase(std::unique(read_vertices.begin(), read_vertices.end()), read_vertices.end());
+    for (auto vertex_id : read_vertices)
+        validate_vertex(vertex_id);
+
+    auto &read_edges = state->read_edges;
+    std::sort(read_edges.begin(), read_edges.end());
+    read_edges.erase(std::unique(read_edges.begin(), read_edges.end()), read_edges.end());
+    for (auto [src, label] : read_edges)
+        validate_edges(src, label);
+
+    // 全图扫描：校验到当前的最大顶点号为止，扫描之后新建的顶点也算冲突
+    auto &scanned_labels = state->scanned_labels;
+    if (!state->scanned_vertices && scanned_labels.empty())
+        return;
+    std::sort(scanned_labels.begin(), scanned_labels.end());
+    scanned_labels.erase(std::unique(scanned_labels.begin(), scanned_labels.end()), scanned_labels.end());
+    vertex_t num_vertices = graph.vertex_id.load(std::memory_order_acquire);
+    for (vertex_t vid = 0; vid < num_vertices; vid++)
+    {
+        if (state->scanned_vertices)
+            validate_vertex(vid);
+        for (auto label : scanned_labels)
+            validate_edges(vid, label);
     }
 }
 
@@ -404,8 +635,8 @@ void Transaction::update_edge_label_block(vertex_t src, label_t label, uintptr_t
 
         if (!batch_update)
         {
-            block_cache.emplace_back(new_pointer, order);
-            timestamps_to_update.emplace_back(new_edge_label_block->get_creation_time_pointer(),
+            state->block_cache.emplace_back(new_pointer, order);
+            state->timestamps_to_update.emplace_back(new_edge_label_block->get_creation_time_pointer(),
                                               Graph::ROLLBACK_TOMBSTONE);
         }
 
@@ -433,17 +664,17 @@ void Transaction::put_edge(vertex_t src, label_t label, vertex_t dst, std::strin
     if (batch_update)
     {
         // 对src上锁
-        graph.vertex_futexes[src].lock();
+        lock_edge_for_batch(src, label);
         // 定位edge block
         pointer = locate_edge_block(src, label);
     }
     else
     {
-        // 对src上锁
-        ensure_vertex_lock(src);
+        // 对<src, label>上锁
+        ensure_edge_lock(src, label);
         // 在 "edge_ptr_cache" 中查找指向<src, label>的edge block的指针，如果找到了，则将其存储在 "pointer" 变量中。
-        auto cache_iter = edge_ptr_cache.find(std::make_pair(src, label));
-        if (cache_iter != edge_ptr_cache.end())
+        auto cache_iter = state->edge_ptr_cache.find(std::make_pair(src, label));
+        if (cache_iter != state->edge_ptr_cache.end())
         {
             pointer = cache_iter->second;
         }
@@ -454,7 +685,7 @@ void Transaction::put_edge(vertex_t src, label_t label, vertex_t dst, std::strin
             pointer = locate_edge_block(src, label);
             // 将新的edge block的指针添加到缓存中
             // cancel cache
-            edge_ptr_cache.emplace_hint(cache_iter, std::make_pair(src, label), pointer);
+            state->edge_ptr_cache.emplace_hint(cache_iter, std::make_pair(src, label), pointer);
         }
     }
 
@@ -475,9 +706,13 @@ void Transaction::put_edge(vertex_t src, label_t label, vertex_t dst, std::strin
 
     if (!edge_block || !edge_block->has_space(entry, num_entries, data_length))
     {
+        // a new edge block changes the label directory at commit
+        if (!batch_update)
+            ensure_vertex_lock(src);
+
         auto size = sizeof(EdgeBlockHeader) + (1 + num_entries) * sizeof(EdgeEntry) + data_length + entry.get_length();
 
-        std::cout << "size: " << size << std::endl;
+        // std::cout << "size: " << size << std::endl;
 
         auto order = size_to_order(size);
 
@@ -495,8 +730,9 @@ void Transaction::put_edge(vertex_t src, label_t label, vertex_t dst, std::strin
 
         if (!batch_update)
         {
-            block_cache.emplace_back(new_pointer, order);
-            timestamps_to_update.emplace_back(new_edge_block->get_creation_time_pointer(), Graph::ROLLBACK_TOMBSTONE);
+            state->block_cache.emplace_back(new_pointer, order);
+            state->timestamps_to_update.emplace_back(new_edge_block->get_creation_time_pointer(),
+                                                     Graph::ROLLBACK_TOMBSTONE);
             // timestamps_to_update.emplace_back(new_edge_block->get_committed_time_pointer(),
             // Graph::ROLLBACK_TOMBSTONE); update when commit
         }
@@ -515,7 +751,8 @@ void Transaction::put_edge(vertex_t src, label_t label, vertex_t dst, std::strin
                 {
                     auto edge = new_edge_block->append(*entries, data, bloom_filter); // direct update size
                     if (!batch_update && edge->get_creation_time() == -local_txn_id)
-                        timestamps_to_update.emplace_back(edge->get_creation_time_pointer(), Graph::ROLLBACK_TOMBSTONE);
+                        state->timestamps_to_update.emplace_back(edge->get_creation_time_pointer(),
+                                                                 Graph::ROLLBACK_TOMBSTONE);
                 }
                 data += entries->get_length();
             }
@@ -537,7 +774,7 @@ void Transaction::put_edge(vertex_t src, label_t label, vertex_t dst, std::strin
         {
             prev_edge.first->set_deletion_time(write_epoch_id);
             if (!batch_update)
-                timestamps_to_update.emplace_back(prev_edge.first->get_deletion_time_pointer(),
+                state->timestamps_to_update.emplace_back(prev_edge.first->get_deletion_time_pointer(),
                                                   Graph::ROLLBACK_TOMBSTONE);
         }
     }
@@ -545,18 +782,25 @@ void Transaction::put_edge(vertex_t src, label_t label, vertex_t dst, std::strin
     auto edge = edge_block->append_without_update_size(entry, edge_data.data(), num_entries, data_length);
     set_num_entries_data_length_cache(edge_block, num_entries + 1, data_length + entry.get_length());
     if (!batch_update)
-        timestamps_to_update.emplace_back(edge->get_creation_time_pointer(), Graph::ROLLBACK_TOMBSTONE);
+        state->timestamps_to_update.emplace_back(edge->get_creation_time_pointer(), Graph::ROLLBACK_TOMBSTONE);
+
+    if (graph.version_index)
+        track_versioned_edge(src, label, dst, entry.get_version());
+    track_changed_edges(src, label);
 
     graph.compact_table.local().emplace(src);
 
     if (batch_update)
     {
-        graph.vertex_futexes[src].unlock();
+        unlock_edge_for_batch(src, label);
+        if (graph.sort_edge_blocks &&
+            (state->unsorted_edge_blocks.empty() || state->unsorted_edge_blocks.back() != std::make_pair(src, label)))
+            state->unsorted_edge_blocks.emplace_back(src, label);
     }
     else
     {
         // cancel cache
-        edge_ptr_cache[std::make_pair(src, label)] = pointer;
+        state->edge_ptr_cache[std::make_pair(src, label)] = pointer;
         ++wal_num_ops();
         wal_append(OPType::PutEdge);
         wal_append(src);
@@ -577,14 +821,14 @@ bool Transaction::del_edge(vertex_t src, label_t label, vertex_t dst)
     uintptr_t pointer;
     if (batch_update)
     {
-        graph.vertex_futexes[src].lock();
+        lock_edge_for_batch(src, label);
         pointer = locate_edge_block(src, label);
     }
     else
     {
-        ensure_vertex_lock(src);
-        auto cache_iter = edge_ptr_cache.find(std::make_pair(src, label));
-        if (cache_iter != edge_ptr_cache.end())
+        ensure_edge_lock(src, label);
+        auto cache_iter = state->edge_ptr_cache.find(std::make_pair(src, label));
+        if (cache_iter != state->edge_ptr_cache.end())
         {
             pointer = cache_iter->second;
         }
@@ -593,14 +837,18 @@ bool Transaction::del_edge(vertex_t src, label_t label, vertex_t dst)
             ensure_no_confict(src, label);
             pointer = locate_edge_block(src, label);
             // cancel cache
-            edge_ptr_cache.emplace_hint(cache_iter, std::make_pair(src, label), pointer);
+            state->edge_ptr_cache.emplace_hint(cache_iter, std::make_pair(src, label), pointer);
         }
     }
 
     auto edge_block = graph.block_manager.convert<EdgeBlockHeader>(pointer);
 
     if (!edge_block)
+    {
+        if (batch_update)
+            unlock_edge_for_batch(src, label);
         return false;
+    }
 
     auto [num_entries, data_length] = get_num_entries_data_length_cache(edge_block);
     auto edge = find_edge(dst, edge_block, num_entries, data_length);
@@ -609,19 +857,21 @@ bool Transaction::del_edge(vertex_t src, label_t label, vertex_t dst)
     {
         edge.first->set_deletion_time(write_epoch_id);
         if (!batch_update)
-            timestamps_to_update.emplace_back(edge.first->get_deletion_time_pointer(), Graph::ROLLBACK_TOMBSTONE);
+            state->timestamps_to_update.emplace_back(edge.first->get_deletion_time_pointer(),
+                                                     Graph::ROLLBACK_TOMBSTONE);
+        track_changed_edges(src, label);
     }
 
     graph.compact_table.local().emplace(src);
 
     if (batch_update)
     {
-        graph.vertex_futexes[src].unlock();
+        unlock_edge_for_batch(src, label);
     }
     else
     {
         // cancel cache
-        edge_ptr_cache[std::make_pair(src, label)] = pointer;
+        state->edge_ptr_cache[std::make_pair(src, label)] = pointer;
 
         // make sure commit will change committed_time
         set_num_entries_data_length_cache(edge_block, num_entries, data_length);
@@ -653,8 +903,8 @@ std::string_view Transaction::get_edge(vertex_t src, label_t label, vertex_t dst
     }
     else
     {
-        auto cache_iter = edge_ptr_cache.find(std::make_pair(src, label));
-        if (cache_iter != edge_ptr_cache.end())
+        auto cache_iter = state->edge_ptr_cache.find(std::make_pair(src, label));
+        if (cache_iter != state->edge_ptr_cache.end())
         {
             pointer = cache_iter->second;
         }
@@ -662,7 +912,9 @@ std::string_view Transaction::get_edge(vertex_t src, label_t label, vertex_t dst
         {
             pointer = locate_edge_block(src, label);
             // cancel cache
-            edge_ptr_cache.emplace_hint(cache_iter, std::make_pair(src, label), pointer);
+            state->edge_ptr_cache.emplace_hint(cache_iter, std::make_pair(src, label), pointer);
+            if (serializable)
+                state->read_edges.emplace_back(src, label);
         }
     }
 
@@ -687,17 +939,22 @@ void Transaction::abort()
 {
     check_valid();
 
-    for (const auto &p : timestamps_to_update)
+    for (const auto &p : state->timestamps_to_update)
     {
         *p.first = p.second;
     }
 
-    for (const auto &vid : new_vertex_cache)
+    for (auto pointer : state->new_key_blocks)
     {
-        graph.recycled_vertex_ids.push(vid);
+        graph.retire_key_block(pointer);
     }
 
-    for (const auto &p : block_cache)
+    for (const auto &vid : state->new_vertex_cache)
+    {
+        graph.recycle_vertex_id(vid);
+    }
+
+    for (const auto &p : state->block_cache)
     {
         graph.block_manager.free(p.first, p.second);
     }
@@ -719,8 +976,8 @@ EdgeIterator Transaction::get_edges(vertex_t src, label_t label, bool reverse)
     }
     else
     {
-        auto cache_iter = edge_ptr_cache.find(std::make_pair(src, label));
-        if (cache_iter != edge_ptr_cache.end())
+        auto cache_iter = state->edge_ptr_cache.find(std::make_pair(src, label));
+        if (cache_iter != state->edge_ptr_cache.end())
         {
             pointer = cache_iter->second;
         }
@@ -728,7 +985,9 @@ EdgeIterator Transaction::get_edges(vertex_t src, label_t label, bool reverse)
         {
             pointer = locate_edge_block(src, label);
             // cancel cache
-            edge_ptr_cache.emplace_hint(cache_iter, std::make_pair(src, label), pointer);
+            state->edge_ptr_cache.emplace_hint(cache_iter, std::make_pair(src, label), pointer);
+            if (serializable)
+                state->read_edges.emplace_back(src, label);
         }
     }
 
@@ -749,11 +1008,18 @@ timestamp_t Transaction::commit(bool wait_visable)
     check_writable();
 
     if (batch_update)
+    {
+        sort_unsorted_edge_blocks();
+        log_changed_edges(read_epoch_id);
         return read_epoch_id;
+    }
+
+    if (serializable)
+        validate_read_set();
 
-    auto [commit_epoch_id, num_unfinished] = graph.commit_manager.register_commit(wal);
+    auto [commit_epoch_id, num_unfinished] = graph.commit_manager.register_commit(state->wal);
 
-    for (const auto &p : vertex_ptr_cache)
+    for (const auto &p : state->vertex_ptr_cache)
     {
         auto vertex_id = p.first;
         auto pointer = p.second;
@@ -761,19 +1027,19 @@ timestamp_t Transaction::commit(bool wait_visable)
             graph.vertex_ptrs[vertex_id] = pointer;
     }
 
-    for (const auto &vid : recycled_vertex_cache)
+    for (const auto &vid : state->recycled_vertex_cache)
     {
-        graph.recycled_vertex_ids.push(vid);
+        graph.recycle_vertex_id(vid);
     }
 
-    for (const auto &p : edge_block_num_entries_data_length_cache)
+    for (const auto &p : state->edge_block_num_entries_data_length_cache)
     {
         p.first->set_num_entries_data_length_atomic(p.second.first, p.second.second);
-        timestamps_to_update.emplace_back(p.first->get_committed_time_pointer(), p.first->get_committed_time());
+        state->timestamps_to_update.emplace_back(p.first->get_committed_time_pointer(), p.first->get_committed_time());
         p.first->set_committed_time(write_epoch_id);
     }
 
-    for (const auto &p : edge_ptr_cache)
+    for (const auto &p : state->edge_ptr_cache)
     {
         auto prev_pointer = locate_edge_block(p.first.first, p.first.second);
         if (p.second != prev_pointer)
@@ -782,11 +1048,17 @@ timestamp_t Transaction::commit(bool wait_visable)
         }
     }
 
-    for (const auto &p : timestamps_to_update)
+    for (const auto &p : state->timestamps_to_update)
     {
         *p.first = commit_epoch_id;
     }
 
+    for (const auto &entry : state->versioned_edges)
+    {
+        graph.version_index->append(entry);
+    }
+    log_changed_edges(commit_epoch_id);
+
     clean();
 
     graph.commit_manager.finish_commit(commit_epoch_id, num_unfinished, wait_visable);
@@ -806,17 +1078,17 @@ void Transaction::put_edge_with_version(vertex_t src, label_t label, vertex_t ds
     if (batch_update)
     {
         // 对src上锁
-        graph.vertex_futexes[src].lock();
+        lock_edge_for_batch(src, label);
         // 定位edge block
         pointer = locate_edge_block(src, label);
     }
     else
     {
-        // 对src上锁
-        ensure_vertex_lock(src);
+        // 对<src, label>上锁
+        ensure_edge_lock(src, label);
         // 在 "edge_ptr_cache" 中查找指向<src, label>的edge block的指针，如果找到了，则将其存储在 "pointer" 变量中。
-        auto cache_iter = edge_ptr_cache.find(std::make_pair(src, label));
-        if (cache_iter != edge_ptr_cache.end())
+        auto cache_iter = state->edge_ptr_cache.find(std::make_pair(src, label));
+        if (cache_iter != state->edge_ptr_cache.end())
         {
             pointer = cache_iter->second;
         }
@@ -827,7 +1099,7 @@ void Transaction::put_edge_with_version(vertex_t src, label_t label, vertex_t ds
             pointer = locate_edge_block(src, label);
             // 将新的edge block的指针添加到缓存中
             // cancel cache
-            edge_ptr_cache.emplace_hint(cache_iter, std::make_pair(src, label), pointer);
+            state->edge_ptr_cache.emplace_hint(cache_iter, std::make_pair(src, label), pointer);
         }
     }
 
@@ -848,6 +1120,10 @@ void Transaction::put_edge_with_version(vertex_t src, label_t label, vertex_t ds
 
     if (!edge_block || !edge_block->has_space(entry, num_entries, data_length))
     {
+        // a new edge block changes the label directory at commit
+        if (!batch_update)
+            ensure_vertex_lock(src);
+
         // std::cout << "not exist or no space" << std::endl;
 
         auto size = sizeof(EdgeBlockHeader) + (1 + num_entries) * sizeof(EdgeEntry) + data_length + entry.get_length();
@@ -867,8 +1143,9 @@ void Transaction::put_edge_with_version(vertex_t src, label_t label, vertex_t ds
 
         if (!batch_update)
         {
-            block_cache.emplace_back(new_pointer, order);
-            timestamps_to_update.emplace_back(new_edge_block->get_creation_time_pointer(), Graph::ROLLBACK_TOMBSTONE);
+            state->block_cache.emplace_back(new_pointer, order);
+            state->timestamps_to_update.emplace_back(new_edge_block->get_creation_time_pointer(),
+                                                     Graph::ROLLBACK_TOMBSTONE);
             // timestamps_to_update.emplace_back(new_edge_block->get_committed_time_pointer(),
             // Graph::ROLLBACK_TOMBSTONE); update when commit
         }
@@ -895,7 +1172,8 @@ void Transaction::put_edge_with_version(vertex_t src, label_t label, vertex_t ds
                     if (!batch_update && edge->get_creation_time() == -local_txn_id)
                     {
                         // std::cout << "remain: " << *edge->get_version_pointer() << std::endl;
-                        timestamps_to_update.emplace_back(edge->get_creation_time_pointer(), Graph::ROLLBACK_TOMBSTONE);
+                        state->timestamps_to_update.emplace_back(edge->get_creation_time_pointer(),
+                                                                 Graph::ROLLBACK_TOMBSTONE);
                     }
                 }
                 else
@@ -923,7 +1201,7 @@ void Transaction::put_edge_with_version(vertex_t src, label_t label, vertex_t ds
         {
             prev_edge.first->set_deletion_time(write_epoch_id);
             if (!batch_update)
-                timestamps_to_update.emplace_back(prev_edge.first->get_deletion_time_pointer(),
+                state->timestamps_to_update.emplace_back(prev_edge.first->get_deletion_time_pointer(),
                                                   Graph::ROLLBACK_TOMBSTONE);
         }
     }
@@ -931,18 +1209,25 @@ void Transaction::put_edge_with_version(vertex_t src, label_t label, vertex_t ds
     auto edge = edge_block->append_without_update_size(entry, edge_data.data(), num_entries, data_length);
     set_num_entries_data_length_cache(edge_block, num_entries + 1, data_length + entry.get_length());
     if (!batch_update)
-        timestamps_to_update.emplace_back(edge->get_creation_time_pointer(), Graph::ROLLBACK_TOMBSTONE);
+        state->timestamps_to_update.emplace_back(edge->get_creation_time_pointer(), Graph::ROLLBACK_TOMBSTONE);
+
+    if (graph.version_index)
+        track_versioned_edge(src, label, dst, entry.get_version());
+    track_changed_edges(src, label);
 
     graph.compact_table.local().emplace(src);
 
     if (batch_update)
     {
-        graph.vertex_futexes[src].unlock();
+        unlock_edge_for_batch(src, label);
+        if (graph.sort_edge_blocks &&
+            (state->unsorted_edge_blocks.empty() || state->unsorted_edge_blocks.back() != std::make_pair(src, label)))
+            state->unsorted_edge_blocks.emplace_back(src, label);
     }
     else
     {
         // cancel cache
-        edge_ptr_cache[std::make_pair(src, label)] = pointer;
+        state->edge_ptr_cache[std::make_pair(src, label)] = pointer;
         ++wal_num_ops();
         wal_append(OPType::PutEdge);
         wal_append(src);
@@ -956,6 +1241,155 @@ void Transaction::put_edge_with_version(vertex_t src, label_t label, vertex_t ds
 
 
 
+void Transaction::track_versioned_edge(vertex_t src, label_t label, vertex_t dst, timestamp_t version)
+{
+    if (batch_update)
+        graph.version_index->append({version, src, label, dst});
+    else
+        state->versioned_edges.push_back({version, src, label, dst});
+}
+
+std::vector<VersionedEdge> Transaction::get_edges_by_version(label_t label, timestamp_t start, timestamp_t end)
+{
+    check_valid();
+    check_serializable_unsupported("get_edges_by_version");
+    if (!graph.version_index)
+        throw std::invalid_argument("The version index is not enabled.");
+
+    // 索引只给出窗口内有边的源顶点（包括本事务尚未提交的边），边本身在快照中从边块读取
+    std::vector<vertex_t> srcs;
+    graph.version_index->scan(start, end, [&](const VersionIndexEntry &entry) {
+        if (entry.label == label)
+            srcs.push_back(entry.src);
+    });
+    for (const auto &entry : state->versioned_edges)
+    {
+        if (entry.label == label && entry.version >= start && entry.version <= end)
+            srcs.push_back(entry.src);
+    }
+    std::sort(srcs.begin(), srcs.end());
+    srcs.erase(std::unique(srcs.begin(), srcs.end()), srcs.end());
+
+    std::vector<VersionedEdge> edges;
+    for (auto src : srcs)
+    {
+        for (auto iter = scan_edge_iterator(src, label); iter.valid(); iter.next())
+        {
+            if (iter.version() >= start && iter.version() <= end)
+                edges.push_back({src, label, iter.dst_id(), iter.version(), iter.edge_data()});
+        }
+    }
+    std::stable_sort(edges.begin(), edges.end(),
+                     [](const VersionedEdge &a, const VersionedEdge &b) { return a.version < b.version; });
+    return edges;
+}
+
+std::vector<EdgeChange> Transaction::get_edge_changes(vertex_t src, label_t label, timestamp_t e1, timestamp_t e2)
+{
+    check_valid();
+    if (e1 > e2 || e2 > read_epoch_id)
+        throw std::invalid_argument("The epochs are out of the snapshot.");
+    track_read_edges(&src, 1, label);
+
+    std::vector<EdgeChange> changes;
+    if (src >= graph.vertex_id.load(std::memory_order_relaxed))
+        return changes;
+
+    auto visible_at = [](EdgeEntry *entry, timestamp_t epoch) {
+        return cmp_timestamp(entry->get_creation_time_pointer(), epoch) <= 0 &&
+               cmp_timestamp(entry->get_deletion_time_pointer(), epoch) > 0;
+    };
+    // Calls f(entry, data) for the entries of a block
+    auto for_each_entry = [](EdgeBlockHeader *edge_block, auto &&f) {
+        auto [num_entries, data_length] = edge_block->get_num_entries_data_length_atomic();
+        auto entries = edge_block->get_entries();
+        auto data = edge_block->get_data();
+        for (size_t i = 0; i < num_entries; i++)
+        {
+            entries--;
+            f(entries, data);
+            data += entries->get_length();
+        }
+    };
+
+    // The blocks of the snapshots at e2 and at e1, and those in between, newest first
+    std::vector<EdgeBlockHeader *> edge_blocks;
+    auto pointer = locate_edge_block(src, label);
+    while (pointer != graph.block_manager.NULLPOINTER)
+    {
+        auto edge_block = graph.block_manager.convert<EdgeBlockHeader>(pointer);
+        if (cmp_timestamp(edge_block->get_creation_time_pointer(), e2) <= 0)
+            edge_blocks.push_back(edge_block);
+        if (cmp_timestamp(edge_block->get_creation_time_pointer(), e1) <= 0)
+            break;
+        pointer = edge_block->get_prev_pointer();
+    }
+    if (edge_blocks.empty())
+        return changes;
+
+    for_each_entry(edge_blocks.front(), [&](EdgeEntry *entry, char *data) {
+        if (visible_at(entry, e2) && cmp_timestamp(entry->get_creation_time_pointer(), e1) > 0)
+            changes.push_back({src, entry->get_dst(), true, entry->get_creation_time(),
+                               std::string_view(data, entry->get_length())});
+    });
+
+    // 新块会丢弃已删除的边，所以一条边的删除时间记在包含它的最新的块里。
+    // 同一条边的副本（dst、创建时间、数据相同）在较新的块中有几个，就跳过本块中未删除的几个。
+    using Key = std::tuple<vertex_t, timestamp_t, std::string_view>;
+    std::map<Key, size_t> newer_copies;
+    for (auto edge_block : edge_blocks)
+    {
+        std::map<Key, std::vector<EdgeEntry *>> copies;
+        for_each_entry(edge_block, [&](EdgeEntry *entry, char *data) {
+            if (visible_at(entry, e1))
+                copies[Key(entry->get_dst(), entry->get_creation_time(), std::string_view(data, entry->get_length()))]
+                    .push_back(entry);
+        });
+        for (auto &[key, entries] : copies)
+        {
+            auto &num_newer = newer_copies[key];
+            std::sort(entries.begin(), entries.end(), [](EdgeEntry *a, EdgeEntry *b) {
+                return (uint64_t)a->get_deletion_time() < (uint64_t)b->get_deletion_time();
+            });
+            for (size_t i = 0; i + num_newer < entries.size(); i++)
+            {
+                if (!visible_at(entries[i], e2))
+                    changes.push_back({src, std::get<0>(key), false, entries[i]->get_deletion_time(), std::get<2>(key)});
+            }
+            num_newer = std::max(num_newer, entries.size());
+        }
+    }
+    return changes;
+}
+
+std::vector<EdgeChange> Transaction::get_edge_changes(label_t label, timestamp_t e1, timestamp_t e2)
+{
+    check_valid();
+    check_serializable_unsupported("get_edge_changes");
+    if (!graph.edge_change_log)
+        throw std::invalid_argument("The edge change log is not enabled.");
+    if (e1 < graph.edge_change_log->get_start_epoch())
+        throw std::invalid_argument("The edge change log starts after the epoch.");
+    if (e1 > e2 || e2 > read_epoch_id)
+        throw std::invalid_argument("The epochs are out of the snapshot.");
+
+    std::vector<vertex_t> srcs;
+    graph.edge_change_log->scan(e1, e2, [&](vertex_t src, label_t changed_label) {
+        if (changed_label == label)
+            srcs.push_back(src);
+    });
+    std::sort(srcs.begin(), srcs.end());
+    srcs.erase(std::unique(srcs.begin(), srcs.end()), srcs.end());
+
+    std::vector<EdgeChange> changes;
+    for (auto src : srcs)
+    {
+        auto src_changes = get_edge_changes(src, label, e1, e2);
+        changes.insert(changes.end(), src_changes.begin(), src_changes.end());
+    }
+    return changes;
+}
+
 std::vector<std::string_view> Transaction::get_edge_with_version(vertex_t src, label_t label, vertex_t dst, timestamp_t start, timestamp_t end)
 {
 
@@ -973,8 +1407,8 @@ std::vector<std::string_view> Transaction::get_edge_with_version(vertex_t src, l
     }
     else
     {
-        auto cache_iter = edge_ptr_cache.find(std::make_pair(src, label));
-        if (cache_iter != edge_ptr_cache.end())
+        auto cache_iter = state->edge_ptr_cache.find(std::make_pair(src, label));
+        if (cache_iter != state->edge_ptr_cache.end())
         {
             pointer = cache_iter->second;
         }
@@ -982,7 +1416,9 @@ std::vector<std::string_view> Transaction::get_edge_with_version(vertex_t src, l
         {
             pointer = locate_edge_block(src, label);
             // cancel cache
-            edge_ptr_cache.emplace_hint(cache_iter, std::make_pair(src, label), pointer);
+            state->edge_ptr_cache.emplace_hint(cache_iter, std::make_pair(src, label), pointer);
+            if (serializable)
+                state->read_edges.emplace_back(src, label);
         }
         // pointer = locate_edge_block(src, label);
     }
@@ -1070,8 +1506,8 @@ EdgeIteratorVersion Transaction::get_edges_with_version(vertex_t src, label_t la
     }
     else
     {
-        auto cache_iter = edge_ptr_cache.find(std::make_pair(src, label));
-        if (cache_iter != edge_ptr_cache.end())
+        auto cache_iter = state->edge_ptr_cache.find(std::make_pair(src, label));
+        if (cache_iter != state->edge_ptr_cache.end())
         {
             pointer = cache_iter->second;
         }
@@ -1079,7 +1515,9 @@ EdgeIteratorVersion Transaction::get_edges_with_version(vertex_t src, label_t la
         {
             pointer = locate_edge_block(src, label);
             // cancel cache
-            edge_ptr_cache.emplace_hint(cache_iter, std::make_pair(src, label), pointer);
+            state->edge_ptr_cache.emplace_hint(cache_iter, std::make_pair(src, label), pointer);
+            if (serializable)
+                state->read_edges.emplace_back(src, label);
         }
         // pointer = locate_edge_block(src, label);
     }
@@ -1105,7 +1543,323 @@ void Transaction::count_size(vertex_t max_vertex_id) {
     // std::cout << "size of edge_ptr_cache: " << sizeof(edge_ptr_cache) / 1024 << " KB" << std::endl;
     // std::cout << "size of vertex_ptrs: " << sizeof(graph.vertex_ptrs) / 1024 << " KB" << std::endl;
     std::cout << "size of edge_label_ptrs: " << max_vertex_id * sizeof(graph.edge_label_ptrs) << " Bytes" << std::endl;
-    size_t edge_ptr_cache_size = sizeof(std::map<std::pair<vertex_t, label_t>, uintptr_t>) + edge_ptr_cache.size() * (sizeof(std::pair<vertex_t, label_t>) + sizeof(uintptr_t));
-    std::cout << "size of edge_ptr_cache: " << edge_ptr_cache_size << " Bytes" << std::endl;
+    size_t edge_ptr_cache_size = state->edge_ptr_cache.memory_usage();
+    std::cout << "size of state->edge_ptr_cache: " << edge_ptr_cache_size << " Bytes" << std::endl;
     std::cout << "size of vertex_ptrs: " << max_vertex_id * sizeof(graph.vertex_ptrs) << " Bytes" << std::endl;
-}
\ No newline at end of file
+}
+
+CSR Transaction::materialize_csr(const std::vector<label_t> &labels, bool with_properties, const std::string &path)
+{
+    return build_csr(labels, with_properties, path,
+                     [&](vertex_t vid, label_t label, auto &&f) { scan_edges(vid, label, f); });
+}
+
+CSR Transaction::materialize_csr_with_version(const std::vector<label_t> &labels, timestamp_t start, timestamp_t end,
+                                              bool with_properties, const std::string &path)
+{
+    return build_csr(labels, with_properties, path, [&](vertex_t vid, label_t label, auto &&f) {
+        scan_edges_with_version(vid, label, start, end, f);
+    });
+}
+
+template <typename S>
+CSR Transaction::build_csr(const std::vector<label_t> &labels, bool with_properties, const std::string &path, S &&scan)
+{
+    check_valid();
+    for (auto label : labels)
+        track_scanned_label(label);
+
+    vertex_t num_vertices = graph.vertex_id.load(std::memory_order_acquire);
+    std::vector<uint64_t> offsets(num_vertices + 1, 0);
+    std::vector<uint64_t> property_offsets(with_properties ? num_vertices + 1 : 0, 0);
+    std::atomic<uint64_t> min_width(UINT64_MAX), max_width(0);
+
+    // Pass 1: degrees and property sizes
+    tbb::parallel_for(tbb::blocked_range<vertex_t>(0, num_vertices), [&](const auto &range) {
+        uint64_t local_min_width = UINT64_MAX, local_max_width = 0;
+        for (vertex_t vid = range.begin(); vid < range.end(); vid++)
+        {
+            uint64_t degree = 0, property_size = 0;
+            for (auto label : labels)
+            {
+                scan(vid, label, [&](vertex_t, std::string_view data) {
+                    degree++;
+                    property_size += data.size();
+                    local_min_width = std::min<uint64_t>(local_min_width, data.size());
+                    local_max_width = std::max<uint64_t>(local_max_width, data.size());
+                });
+            }
+            offsets[vid + 1] = degree;
+            if (with_properties)
+                property_offsets[vid + 1] = property_size;
+        }
+        auto cur_min = min_width.load();
+        while (local_min_width < cur_min && !min_width.compare_exchange_weak(cur_min, local_min_width))
+            ;
+        auto cur_max = max_width.load();
+        while (local_max_width > cur_max && !max_width.compare_exchange_weak(cur_max, local_max_width))
+            ;
+    });
+
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::partial_sum(property_offsets.begin(), property_offsets.end(), property_offsets.begin());
+    uint64_t num_edges = offsets[num_vertices];
+
+    uint64_t property_width = CSR::NO_PROPERTY;
+    if (with_properties)
+    {
+        if (num_edges && min_width == max_width && min_width > 0)
+            property_width = min_width;
+        else
+            property_width = CSR::VARIABLE_WIDTH;
+    }
+    uint64_t property_data_size = with_properties ? property_offsets[num_vertices] : 0;
+
+    auto csr = CSR::create(path, num_vertices, num_edges, labels.size(), property_width, property_data_size,
+                           read_epoch_id);
+    const auto &header = csr.header();
+    std::copy(offsets.begin(), offsets.end(), csr.mutable_array<uint64_t>(header.offsets_offset));
+    auto dsts = csr.mutable_array<vertex_t>(header.dsts_offset);
+    auto edge_labels = csr.mutable_array<label_t>(header.labels_offset);
+    auto edge_property_offsets = csr.mutable_array<uint64_t>(header.property_offsets_offset);
+    auto property_data = csr.mutable_array<char>(header.property_data_offset);
+
+    // Pass 2: fill. The snapshot is stable, so every vertex yields exactly the edges counted in pass 1.
+    tbb::parallel_for(tbb::blocked_range<vertex_t>(0, num_vertices), [&](const auto &range) {
+        for (vertex_t vid = range.begin(); vid < range.end(); vid++)
+        {
+            uint64_t edge = offsets[vid];
+            uint64_t property_offset = with_properties ? property_offsets[vid] : 0;
+            for (auto label : labels)
+            {
+                scan(vid, label, [&](vertex_t dst, std::string_view data) {
+                    if (edge >= offsets[vid + 1])
+                        throw std::runtime_error("The snapshot changed while materializing.");
+                    dsts[edge] = dst;
+                    if (edge_labels)
+                        edge_labels[edge] = label;
+                    if (edge_property_offsets)
+                        edge_property_offsets[edge] = property_offset;
+                    if (with_properties)
+                    {
+                        std::memcpy(property_data + property_offset, data.data(), data.size());
+                        property_offset += data.size();
+                    }
+                    edge++;
+                });
+            }
+        }
+    });
+    if (edge_property_offsets)
+        edge_property_offsets[num_edges] = property_data_size;
+
+    csr.sync();
+    return csr;
+}
+
+void Transaction::collect_sorted_neighbors(EdgeIterator iter, std::vector<vertex_t> &out)
+{
+    out.clear();
+    size_t num_sorted = 0;
+    for (; iter.valid(); iter.next())
+    {
+        auto dst = iter.dst_id();
+        if (num_sorted == out.size() && (out.empty() || out.back() <= dst))
+            num_sorted++;
+        out.push_back(dst);
+    }
+    // Edges appended after the block was sorted form an unsorted tail
+    if (num_sorted < out.size())
+    {
+        std::sort(out.begin() + num_sorted, out.end());
+        std::inplace_merge(out.begin(), out.begin() + num_sorted, out.end());
+    }
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+std::vector<vertex_t> Transaction::intersect(vertex_t src_a, vertex_t src_b, label_t label)
+{
+    thread_local std::vector<vertex_t> neighbors_a, neighbors_b;
+    collect_sorted_neighbors(get_edges(src_a, label, true), neighbors_a);
+    collect_sorted_neighbors(get_edges(src_b, label, true), neighbors_b);
+
+    std::vector<vertex_t> result(std::min(neighbors_a.size(), neighbors_b.size()));
+    result.resize(SortedIntersection::intersect(neighbors_a.data(), neighbors_a.size(), neighbors_b.data(),
+                                                neighbors_b.size(), result.data()));
+    return result;
+}
+
+size_t Transaction::count_triangles(label_t label, size_t grain_size)
+{
+    check_valid();
+    track_scanned_label(label);
+    vertex_t num_vertices = graph.vertex_id.load(std::memory_order_acquire);
+    // Each triangle u < v < w is counted once, from its smallest vertex, so only the larger neighbours of every
+    // vertex are needed; collect and sort them once instead of for every edge reaching the vertex
+    std::vector<std::vector<vertex_t>> larger_neighbors(num_vertices);
+    tbb::parallel_for(tbb::blocked_range<vertex_t>(0, num_vertices, grain_size), [&](const auto &range) {
+        std::vector<vertex_t> neighbors;
+        for (vertex_t u = range.begin(); u < range.end(); u++)
+        {
+            collect_sorted_neighbors(scan_edge_iterator(u, label, true), neighbors);
+            larger_neighbors[u].assign(std::upper_bound(neighbors.begin(), neighbors.end(), u), neighbors.end());
+        }
+    });
+    return tbb::parallel_reduce(
+        tbb::blocked_range<vertex_t>(0, num_vertices, grain_size), (size_t)0,
+        [&](const auto &range, size_t count) {
+            for (vertex_t u = range.begin(); u < range.end(); u++)
+            {
+                const auto &u_neighbors = larger_neighbors[u];
+                for (size_t i = 0; i < u_neighbors.size(); i++)
+                {
+                    const auto &v_neighbors = larger_neighbors[u_neighbors[i]];
+                    count += SortedIntersection::intersect(u_neighbors.data() + i + 1, u_neighbors.size() - i - 1,
+                                                           v_neighbors.data(), v_neighbors.size());
+                }
+            }
+            return count;
+        },
+        std::plus<>());
+}
+
+void Transaction::track_read_edges(const vertex_t *srcs, size_t num_srcs, label_t label)
+{
+    if (batch_update || !trace_cache || !serializable)
+        return;
+    for (size_t i = 0; i < num_srcs; i++)
+        state->read_edges.emplace_back(srcs[i], label);
+}
+
+std::vector<EdgeBlockHeader *>
+Transaction::locate_edge_blocks(const vertex_t *srcs, size_t num_srcs, label_t label, size_t group_size)
+{
+    check_valid();
+    track_read_edges(srcs, num_srcs, label);
+
+    std::vector<EdgeBlockHeader *> edge_blocks(num_srcs, nullptr);
+    interleaved_locate(srcs, num_srcs, label, group_size,
+                       [&](size_t index, EdgeBlockHeader *edge_block) { edge_blocks[index] = edge_block; });
+    return edge_blocks;
+}
+
+std::vector<EdgeIterator>
+Transaction::get_edges_batch(const vertex_t *srcs, size_t num_srcs, label_t label, size_t group_size)
+{
+    std::vector<EdgeIterator> iters;
+    iters.reserve(num_srcs);
+    for (auto edge_block : locate_edge_blocks(srcs, num_srcs, label, group_size))
+    {
+        if (!edge_block)
+        {
+            iters.emplace_back(nullptr, nullptr, 0, 0, read_epoch_id, local_txn_id, false);
+            continue;
+        }
+        auto [num_entries, data_length] = get_num_entries_data_length_cache(edge_block);
+        iters.emplace_back(edge_block->get_entries(), edge_block->get_data(), num_entries, data_length,
+                           read_epoch_id, local_txn_id, false);
+    }
+    return iters;
+}
+
+std::vector<EdgeIteratorVersion> Transaction::get_edges_batch(
+    const vertex_t *srcs, size_t num_srcs, label_t label, timestamp_t start, timestamp_t end, size_t group_size)
+{
+    std::vector<EdgeIteratorVersion> iters;
+    iters.reserve(num_srcs);
+    for (auto edge_block : locate_edge_blocks(srcs, num_srcs, label, group_size))
+    {
+        if (!edge_block)
+        {
+            iters.emplace_back(nullptr, nullptr, 0, 0, read_epoch_id, local_txn_id, start, end, false);
+            continue;
+        }
+        auto [num_entries, data_length] = get_num_entries_data_length_cache(edge_block);
+        iters.emplace_back(edge_block->get_entries(), edge_block->get_data(), num_entries, data_length,
+                           read_epoch_id, local_txn_id, start, end, false);
+    }
+    return iters;
+}
+
+std::vector<uint32_t> Transaction::bfs(vertex_t root, label_t label, size_t group_size)
+{
+    check_valid();
+    vertex_t num_vertices = graph.vertex_id.load(std::memory_order_acquire);
+    if (root >= num_vertices)
+        throw std::invalid_argument("The vertex id is invalid.");
+
+    std::vector<uint32_t> distances(num_vertices, NOT_REACHED);
+    std::vector<vertex_t> frontier{root}, next_frontier;
+    distances[root] = 0;
+    for (uint32_t level = 1; !frontier.empty(); level++)
+    {
+        next_frontier.clear();
+        track_read_edges(frontier.data(), frontier.size(), label);
+        interleaved_scan(frontier.data(), frontier.size(), label, group_size,
+                         [&](size_t, vertex_t dst, std::string_view) {
+                             if (distances[dst] == NOT_REACHED)
+                             {
+                                 distances[dst] = level;
+                                 next_frontier.push_back(dst);
+                             }
+                         });
+        frontier.swap(next_frontier);
+    }
+    return distances;
+}
+
+void Transaction::collect_pattern_slot(const PatternEdge &edge, bool reverse, vertex_t vertex,
+                                       std::vector<vertex_t> &out)
+{
+    auto label = reverse ? edge.reverse_label : edge.label;
+    if (!edge.windowed)
+    {
+        collect_sorted_neighbors(scan_edge_iterator(vertex, label, true), out);
+        return;
+    }
+    // The versioned iterator only goes newest first, which is descending for a sorted block
+    out.clear();
+    for (auto iter = scan_edge_iterator_with_version(vertex, label, edge.start, edge.end); iter.valid(); iter.next())
+        out.push_back(iter.dst_id());
+    if (std::is_sorted(out.rbegin(), out.rend()))
+        std::reverse(out.begin(), out.end());
+    else
+        std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+size_t Transaction::count_pattern(const Pattern &pattern, size_t grain_size)
+{
+    tbb::combinable<size_t> counts([]() { return (size_t)0; });
+    match_pattern(pattern, [&](const vertex_t *) { counts.local()++; }, grain_size);
+    return counts.combine(std::plus<>());
+}
+
+void Transaction::sort_unsorted_edge_blocks()
+{
+    auto &unsorted_edge_blocks = state->unsorted_edge_blocks;
+    std::sort(unsorted_edge_blocks.begin(), unsorted_edge_blocks.end());
+    unsorted_edge_blocks.erase(std::unique(unsorted_edge_blocks.begin(), unsorted_edge_blocks.end()),
+                               unsorted_edge_blocks.end());
+    for (auto [src, label] : unsorted_edge_blocks)
+    {
+        lock_edge_for_batch(src, label);
+        auto pointer = locate_edge_block(src, label);
+        auto edge_block = graph.block_manager.convert<EdgeBlockHeader>(pointer);
+        auto num_entries = edge_block ? edge_block->get_num_entries() : 0;
+        if (edge_block && edge_block->get_num_sorted_entries(num_entries) < num_entries)
+        {
+            // Readers may be scanning the block, so the sorted copy is a new block, as in compaction; the old one
+            // stays in the chain until compaction frees it
+            auto order = edge_block->get_order();
+            auto new_pointer = graph.block_manager.alloc(order);
+            auto new_edge_block = graph.block_manager.convert<EdgeBlockHeader>(new_pointer);
+            new_edge_block->fill(order, src, write_epoch_id, pointer, edge_block->get_committed_time());
+            new_edge_block->append_sorted(edge_block, num_entries, [](const EdgeEntry &) { return true; });
+            update_edge_label_block(src, label, new_pointer);
+            graph.compact_table.local().emplace(src);
+        }
+        unlock_edge_for_batch(src, label);
+    }
+    unsorted_edge_blocks.clear();
+}
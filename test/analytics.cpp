@@ -0,0 +1,332 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <doctest/doctest.h>
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "core/analytics.hpp"
+#include "core/livegraph.hpp"
+#include "core/traversal.hpp"
+
+using namespace livegraph;
+
+TEST_CASE("testing the analytics")
+{
+    const vertex_t num_vertices = 2000;
+    const size_t num_edges = 6000;
+    Graph graph;
+    std::vector<std::vector<std::pair<vertex_t, double>>> adjacency(num_vertices);
+    {
+        std::mt19937_64 rng(0);
+        auto txn = graph.begin_batch_loader();
+        for (vertex_t i = 0; i < num_vertices; i++)
+            txn.new_vertex();
+        for (size_t i = 0; i < num_edges; i++)
+        {
+            // Sources are skewed so that some vertices are isolated
+            vertex_t src = rng() % (num_vertices / 2) * 2 % num_vertices, dst = rng() % (num_vertices * 3 / 4);
+            double weight = rng() % 100 / 10.0;
+            if (txn.get_edge(src, 0, dst).size())
+                continue;
+            txn.put_edge(src, 0, dst, std::string((char *)&weight, sizeof(weight)));
+            adjacency[src].emplace_back(dst, weight);
+        }
+        txn.commit();
+    }
+    auto txn = graph.begin_read_only_transaction();
+    auto csr = txn.materialize_csr({0}, true);
+
+    SUBCASE("PageRank")
+    {
+        auto ranks = analytics::pagerank(csr, {0.85, 100, 1e-10});
+        REQUIRE(ranks.size() == num_vertices);
+        double sum = 0;
+        for (auto rank : ranks)
+            sum += rank;
+        CHECK(sum == doctest::Approx(1));
+
+        // Serial power iteration as the reference
+        std::vector<double> expected(num_vertices, 1.0 / num_vertices);
+        for (int iteration = 0; iteration < 100; iteration++)
+        {
+            std::vector<double> next(num_vertices, 0);
+            double dangling = 0;
+            for (vertex_t v = 0; v < num_vertices; v++)
+            {
+                if (adjacency[v].empty())
+                    dangling += expected[v];
+                for (auto [u, w] : adjacency[v])
+                    next[u] += 0.85 * expected[v] / adjacency[v].size();
+            }
+            for (auto &rank : next)
+                rank += (0.15 + 0.85 * dangling) / num_vertices;
+            expected.swap(next);
+        }
+        for (vertex_t v = 0; v < num_vertices; v++)
+            CHECK(ranks[v] == doctest::Approx(expected[v]).epsilon(1e-6));
+    }
+
+    SUBCASE("WCC")
+    {
+        auto components = analytics::wcc(csr);
+        std::vector<std::vector<vertex_t>> undirected(num_vertices);
+        for (vertex_t v = 0; v < num_vertices; v++)
+            for (auto [u, w] : adjacency[v])
+            {
+                undirected[v].push_back(u);
+                undirected[u].push_back(v);
+            }
+        std::vector<vertex_t> expected(num_vertices, num_vertices);
+        for (vertex_t s = 0; s < num_vertices; s++)
+        {
+            if (expected[s] != num_vertices)
+                continue;
+            std::vector<vertex_t> stack{s};
+            expected[s] = s;
+            while (!stack.empty())
+            {
+                auto v = stack.back();
+                stack.pop_back();
+                for (auto u : undirected[v])
+                    if (expected[u] == num_vertices)
+                    {
+                        expected[u] = s;
+                        stack.push_back(u);
+                    }
+            }
+        }
+        CHECK(components == expected);
+    }
+
+    SUBCASE("SSSP")
+    {
+        auto weight = [](std::string_view data) {
+            double w;
+            std::memcpy(&w, data.data(), sizeof(w));
+            return w;
+        };
+        auto distances = analytics::sssp(csr, 0, 2.5, weight);
+
+        std::vector<double> expected(num_vertices, analytics::UNREACHABLE);
+        std::priority_queue<std::pair<double, vertex_t>, std::vector<std::pair<double, vertex_t>>, std::greater<>>
+            queue;
+        expected[0] = 0;
+        queue.emplace(0, 0);
+        while (!queue.empty())
+        {
+            auto [d, v] = queue.top();
+            queue.pop();
+            if (d > expected[v])
+                continue;
+            for (auto [u, w] : adjacency[v])
+                if (d + w < expected[u])
+                {
+                    expected[u] = d + w;
+                    queue.emplace(expected[u], u);
+                }
+        }
+        for (vertex_t v = 0; v < num_vertices; v++)
+            CHECK(distances[v] == doctest::Approx(expected[v]));
+
+        auto hops = analytics::sssp(csr, 0);
+        CHECK(hops[0] == 0);
+        for (auto [u, w] : adjacency[0])
+            CHECK(hops[u] == (u == 0 ? 0 : 1));
+        CHECK_THROWS_AS(analytics::sssp(csr, num_vertices), std::invalid_argument);
+    }
+
+    SUBCASE("k-hop reach estimation")
+    {
+        const size_t max_hops = 3;
+        analytics::ReachEstimator estimator(csr, max_hops, 10, true);
+        CHECK(estimator.get_num_vertices() == num_vertices);
+
+        auto exact_reach = [&](std::vector<vertex_t> sources, size_t hops) {
+            std::vector<bool> visited(num_vertices, false);
+            for (auto v : sources)
+                visited[v] = true;
+            for (size_t hop = 0; hop < hops; hop++)
+            {
+                std::vector<vertex_t> next;
+                for (auto v : sources)
+                    for (auto [u, w] : adjacency[v])
+                        if (!visited[u])
+                        {
+                            visited[u] = true;
+                            next.push_back(u);
+                        }
+                sources.swap(next);
+            }
+            return (double)std::count(visited.begin(), visited.end(), true);
+        };
+
+        double total_error = 0;
+        size_t num_queries = 0;
+        for (vertex_t v = 0; v < num_vertices; v += 7)
+        {
+            CHECK(estimator.estimate(v, 0) == doctest::Approx(1).epsilon(0.01));
+            for (size_t hops = 1; hops <= max_hops; hops++)
+            {
+                auto expected = exact_reach({v}, hops);
+                auto estimate = estimator.estimate(v, hops);
+                CHECK(std::fabs(estimate - expected) <= std::max(0.2 * expected, 2.0));
+                total_error += std::fabs(estimate - expected) / expected;
+                num_queries++;
+            }
+        }
+        CHECK(total_error / num_queries < 0.05);
+
+        std::vector<vertex_t> sources{0, 2, 4, 6, 8};
+        CHECK(estimator.estimate(sources.data(), sources.size(), 2) ==
+              doctest::Approx(exact_reach(sources, 2)).epsilon(0.15));
+        CHECK_THROWS_AS(estimator.estimate(0, max_hops + 1), std::invalid_argument);
+        CHECK_THROWS_AS(estimator.estimate(num_vertices, 1), std::invalid_argument);
+        CHECK_THROWS_AS(analytics::ReachEstimator(csr, 1, 2), std::invalid_argument);
+        CHECK_THROWS_AS(analytics::ReachEstimator(csr, 1, 17), std::invalid_argument);
+
+        // Without the sketches only the per-hop estimates are kept
+        analytics::ReachEstimator compact(csr, max_hops, 10);
+        for (vertex_t v = 0; v < num_vertices; v += 7)
+            for (size_t hops = 0; hops <= max_hops; hops++)
+                CHECK(compact.estimate(v, hops) == estimator.estimate(v, hops));
+        CHECK_THROWS_AS(compact.estimate(sources.data(), sources.size(), 2), std::runtime_error);
+    }
+}
+
+TEST_CASE("testing the analytics with a version window")
+{
+    Graph graph;
+    {
+        auto txn = graph.begin_transaction();
+        for (vertex_t i = 0; i < 4; i++)
+            txn.new_vertex();
+        txn.put_edge_with_version(0, 0, 1, "", 1);
+        txn.put_edge_with_version(1, 0, 2, "", 2);
+        txn.put_edge_with_version(2, 0, 3, "", 5);
+        txn.commit();
+    }
+    auto txn = graph.begin_read_only_transaction();
+    auto csr = txn.materialize_csr_with_version({0}, 1, 2);
+    CHECK(csr.get_num_edges() == 2);
+    auto components = analytics::wcc(csr);
+    CHECK(components == std::vector<vertex_t>{0, 0, 0, 3});
+    auto hops = analytics::sssp(csr, 0);
+    CHECK(hops[2] == 2);
+    CHECK(hops[3] == analytics::UNREACHABLE);
+}
+
+TEST_CASE("testing the shortest path")
+{
+    const vertex_t num_vertices = 300;
+    const size_t num_edges = 600;
+    const timestamp_t start = 10, end = 90;
+    Graph graph;
+    std::vector<std::tuple<vertex_t, vertex_t, timestamp_t>> edges;
+    {
+        std::mt19937_64 rng(1);
+        auto txn = graph.begin_transaction();
+        for (vertex_t i = 0; i < num_vertices; i++)
+            txn.new_vertex();
+        for (size_t i = 0; i < num_edges; i++)
+        {
+            vertex_t src = rng() % num_vertices, dst = rng() % num_vertices;
+            int version = rng() % 100;
+            txn.put_edge_with_version(src, 0, dst, "", version, true);
+            txn.put_edge_with_version(dst, 1, src, "", version, true);
+            if (version >= start && version <= end)
+                edges.emplace_back(src, dst, version);
+        }
+        txn.commit();
+    }
+    auto txn = graph.begin_read_only_transaction();
+
+    // Reference: earliest arrival within k hops, for k = 1, 2, ...
+    auto reference = [&](vertex_t src, vertex_t dst, bool time_respecting, size_t max_hops) -> size_t {
+        const timestamp_t unreached = INT64_MAX;
+        std::vector<timestamp_t> arrival(num_vertices, unreached);
+        arrival[src] = INT64_MIN;
+        for (size_t k = 1; k <= max_hops; k++)
+        {
+            auto next = arrival;
+            for (auto [u, v, t] : edges)
+                if (arrival[u] != unreached && (!time_respecting || arrival[u] <= t))
+                    next[v] = std::min(next[v], time_respecting ? t : 0);
+            arrival.swap(next);
+            if (arrival[dst] != unreached)
+                return k;
+        }
+        return SIZE_MAX;
+    };
+
+    auto check_path = [&](const analytics::Path &path, vertex_t src, vertex_t dst, bool time_respecting) {
+        REQUIRE(path.vertices.size() == path.versions.size() + 1);
+        CHECK(path.vertices.front() == src);
+        CHECK(path.vertices.back() == dst);
+        for (size_t i = 0; i < path.versions.size(); i++)
+        {
+            auto edge = std::make_tuple(path.vertices[i], path.vertices[i + 1], path.versions[i]);
+            CHECK(std::find(edges.begin(), edges.end(), edge) != edges.end());
+            if (time_respecting && i)
+                CHECK(path.versions[i - 1] <= path.versions[i]);
+        }
+    };
+
+    std::mt19937_64 rng(2);
+    for (int i = 0; i < 200; i++)
+    {
+        vertex_t src = rng() % num_vertices, dst = rng() % num_vertices;
+        for (bool time_respecting : {false, true})
+        {
+            for (label_t reverse_label : {(label_t)1, analytics::PathOptions::NO_REVERSE_LABEL})
+            {
+                analytics::PathOptions options;
+                options.reverse_label = reverse_label;
+                options.time_respecting = time_respecting;
+                options.max_hops = 8;
+                auto path = analytics::shortest_path(txn, src, dst, 0, start, end, options);
+                auto expected = src == dst ? 0 : reference(src, dst, time_respecting, options.max_hops);
+                if (expected == SIZE_MAX)
+                {
+                    CHECK(!path.found());
+                    continue;
+                }
+                REQUIRE(path.found());
+                CHECK(path.versions.size() == expected);
+                check_path(path, src, dst, time_respecting);
+            }
+        }
+    }
+
+    SUBCASE("hop limit")
+    {
+        vertex_t src = std::get<0>(edges[0]), dst = std::get<1>(edges[0]);
+        auto length = reference(src, dst, false, num_vertices);
+        analytics::PathOptions options;
+        options.reverse_label = 1;
+        options.max_hops = length - 1;
+        if (src != dst)
+            CHECK(!analytics::shortest_path(txn, src, dst, 0, start, end, options).found());
+        options.max_hops = length;
+        CHECK(analytics::shortest_path(txn, src, dst, 0, start, end, options).found());
+    }
+}
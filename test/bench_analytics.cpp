@@ -0,0 +1,112 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Analytics kernels on a synthetic power-law (R-MAT) graph, including the time to materialize the snapshot, and the
+// build and query time of the k-hop reach estimator.
+// Usage: bench_analytics [scale] [edge_factor]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "core/analytics.hpp"
+#include "core/livegraph.hpp"
+
+using namespace livegraph;
+
+template <typename F> double timed(F &&f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    size_t scale = argc > 1 ? std::atoi(argv[1]) : 18;
+    size_t edge_factor = argc > 2 ? std::atoi(argv[2]) : 16;
+    vertex_t num_vertices = 1ul << scale;
+    size_t num_edges = num_vertices * edge_factor;
+
+    Graph graph;
+    double load_time = timed([&]() {
+        auto txn = graph.begin_batch_loader();
+        for (vertex_t i = 0; i < num_vertices; i++)
+            txn.new_vertex();
+        // Graph500 R-MAT parameters
+        std::mt19937_64 rng(0);
+        std::uniform_real_distribution<double> uniform(0, 1);
+        for (size_t i = 0; i < num_edges; i++)
+        {
+            vertex_t src = 0, dst = 0;
+            for (size_t bit = 0; bit < scale; bit++)
+            {
+                double r = uniform(rng);
+                src = src << 1 | (r >= 0.76);
+                dst = dst << 1 | ((r >= 0.57 && r < 0.76) || r >= 0.95);
+            }
+            float weight = uniform(rng);
+            txn.put_edge(src, 0, dst, std::string((char *)&weight, sizeof(weight)), true);
+        }
+        txn.commit();
+    });
+    printf("vertices: %lu, edges: %lu, load: %.3f s\n", num_vertices, num_edges, load_time);
+
+    auto txn = graph.begin_read_only_transaction();
+    CSR csr;
+    printf("materialize_csr: %.3f s\n", timed([&]() { csr = txn.materialize_csr({0}, true); }));
+
+    std::vector<double> ranks;
+    printf("pagerank: %.3f s\n", timed([&]() { ranks = analytics::pagerank(csr); }));
+
+    std::vector<vertex_t> components;
+    printf("wcc: %.3f s\n", timed([&]() { components = analytics::wcc(csr); }));
+
+    // Start from the vertex with the largest out-degree, so that most of the graph is reached
+    vertex_t source = 0;
+    for (vertex_t v = 0; v < num_vertices; v++)
+        if (csr.get_degree(v) > csr.get_degree(source))
+            source = v;
+    std::vector<double> distances;
+    printf("sssp: %.3f s\n", timed([&]() {
+               distances = analytics::sssp(csr, source, 0.1, [&](std::string_view data) {
+                   return (double)*reinterpret_cast<const float *>(data.data());
+               });
+           }));
+
+    std::unique_ptr<analytics::ReachEstimator> estimator;
+    printf("reach estimator: %.3f s\n", timed([&]() { estimator = std::make_unique<analytics::ReachEstimator>(csr); }));
+    const size_t num_queries = 1000000;
+    double estimate = 0;
+    double query_time = timed([&]() {
+        for (size_t i = 0; i < num_queries; i++)
+            estimate += estimator->estimate(i % num_vertices, 3);
+    });
+    printf("3-hop reach estimate: %.3f us per query, mean %.1f\n", query_time / num_queries * 1e6,
+           estimate / num_queries);
+
+    size_t num_components = 0, num_reached = 0;
+    for (vertex_t v = 0; v < num_vertices; v++)
+    {
+        num_components += components[v] == v;
+        num_reached += distances[v] != analytics::UNREACHABLE;
+    }
+    printf("components: %lu, reached from %lu: %lu, rank of %lu: %.6f\n", num_components, source, num_reached,
+           source, ranks[source]);
+    return 0;
+}
@@ -0,0 +1,91 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput of small write-heavy read-write transactions.
+// Usage: bench_transaction [num_threads] [num_txns_per_thread] [num_edges_per_txn] [num_vertices] [num_labels]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "core/livegraph.hpp"
+
+using namespace livegraph;
+
+int main(int argc, char **argv)
+{
+    size_t num_threads = argc > 1 ? std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    size_t num_txns = argc > 2 ? std::atoi(argv[2]) : 100000;
+    size_t num_edges = argc > 3 ? std::atoi(argv[3]) : 16;
+    vertex_t num_vertices = argc > 4 ? std::atoi(argv[4]) : 1000000;
+    label_t num_labels = argc > 5 ? std::atoi(argv[5]) : 4;
+
+    Graph graph;
+    {
+        auto txn = graph.begin_batch_loader();
+        for (vertex_t i = 0; i < num_vertices; i++)
+            txn.new_vertex();
+        txn.commit();
+    }
+
+    std::vector<std::thread> threads;
+    std::vector<size_t> num_commits(num_threads), num_rollbacks(num_threads);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < num_threads; t++)
+    {
+        threads.emplace_back([&, t]() {
+            std::mt19937_64 rng(t);
+            for (size_t i = 0; i < num_txns; i++)
+            {
+                auto txn = graph.begin_transaction();
+                try
+                {
+                    for (size_t j = 0; j < num_edges; j++)
+                    {
+                        vertex_t src = rng() % num_vertices;
+                        label_t label = rng() % num_labels;
+                        txn.put_edge(src, label, rng() % num_vertices, "edge");
+                        // read back through the per-transaction caches
+                        txn.get_edges(src, label).valid();
+                    }
+                    txn.commit(false);
+                    num_commits[t]++;
+                }
+                catch (const Transaction::RollbackExcept &)
+                {
+                    txn.abort();
+                    num_rollbacks[t]++;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t commits = 0, rollbacks = 0;
+    for (size_t t = 0; t < num_threads; t++)
+    {
+        commits += num_commits[t];
+        rollbacks += num_rollbacks[t];
+    }
+    printf("threads: %lu, edges/txn: %lu, time: %.3f s\n", num_threads, num_edges, seconds);
+    printf("commits: %lu (%.0f txn/s, %.0f edges/s), rollbacks: %lu\n", commits, commits / seconds,
+           commits * num_edges / seconds, rollbacks);
+    return 0;
+}
@@ -0,0 +1,114 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// BFS on a uniform random graph whose adjacency lists are scattered over memory: a plain get_edges loop against
+// Transaction::bfs, which interleaves the adjacency list lookups of group_size frontier vertices; then one hop from a
+// random frontier with get_edges_with_version per vertex against get_edges_batch.
+// Usage: bench_traversal [scale] [edge_factor]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "core/livegraph.hpp"
+
+using namespace livegraph;
+
+template <typename F> double timed(F &&f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    size_t scale = argc > 1 ? std::atoi(argv[1]) : 22;
+    size_t edge_factor = argc > 2 ? std::atoi(argv[2]) : 8;
+    vertex_t num_vertices = 1ul << scale;
+    size_t num_edges = num_vertices * edge_factor;
+
+    Graph graph;
+    double load_time = timed([&]() {
+        auto txn = graph.begin_batch_loader();
+        for (vertex_t i = 0; i < num_vertices; i++)
+            txn.new_vertex();
+        std::mt19937_64 rng(0);
+        std::uniform_int_distribution<vertex_t> uniform(0, num_vertices - 1);
+        for (size_t i = 0; i < num_edges; i++)
+            txn.put_edge(uniform(rng), 0, uniform(rng), "", true);
+        txn.commit();
+    });
+    printf("vertices: %lu, edges: %lu, load: %.3f s\n", num_vertices, num_edges, load_time);
+
+    auto txn = graph.begin_read_only_transaction();
+    std::vector<uint32_t> expected;
+    double plain_time = timed([&]() {
+        expected.assign(num_vertices, Transaction::NOT_REACHED);
+        std::vector<vertex_t> queue{0};
+        expected[0] = 0;
+        for (size_t i = 0; i < queue.size(); i++)
+        {
+            for (auto iter = txn.get_edges(queue[i], 0); iter.valid(); iter.next())
+            {
+                if (expected[iter.dst_id()] == Transaction::NOT_REACHED)
+                {
+                    expected[iter.dst_id()] = expected[queue[i]] + 1;
+                    queue.push_back(iter.dst_id());
+                }
+            }
+        }
+    });
+    printf("get_edges: %.3f s\n", plain_time);
+
+    for (size_t group_size : {1, 4, 8, 16, 32, 64})
+    {
+        std::vector<uint32_t> distances;
+        double time = timed([&]() { distances = txn.bfs(0, 0, group_size); });
+        printf("bfs group %2lu: %.3f s (%.2fx)%s\n", group_size, time, plain_time / time,
+               distances == expected ? "" : " MISMATCH");
+    }
+
+    // One hop from a random frontier of a quarter of the vertices, in windows of 64K vertices
+    std::mt19937_64 rng(1);
+    std::vector<vertex_t> frontier(num_vertices / 4);
+    for (auto &vertex : frontier)
+        vertex = rng() % num_vertices;
+    const size_t window = 1 << 16;
+    size_t expected_edges = 0, batch_edges = 0;
+    double single_time = timed([&]() {
+        for (auto vertex : frontier)
+            for (auto iter = txn.get_edges_with_version(vertex, 0, 0, INT64_MAX); iter.valid(); iter.next())
+                expected_edges += iter.dst_id() != num_vertices;
+    });
+    double batch_time = timed([&]() {
+        for (size_t i = 0; i < frontier.size(); i += window)
+        {
+            auto iters = txn.get_edges_batch(frontier.data() + i, std::min(window, frontier.size() - i), 0, 0,
+                                             INT64_MAX);
+            for (auto &iter : iters)
+                for (; iter.valid(); iter.next())
+                    batch_edges += iter.dst_id() != num_vertices;
+        }
+    });
+    printf("get_edges_with_version: %.3f s, get_edges_batch: %.3f s (%.2fx)%s\n", single_time, batch_time,
+           single_time / batch_time, expected_edges == batch_edges ? "" : " MISMATCH");
+    return 0;
+}
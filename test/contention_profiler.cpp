@@ -0,0 +1,78 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <doctest/doctest.h>
+
+#include "core/contention_profiler.hpp"
+#include "core/livegraph.hpp"
+
+using namespace livegraph;
+
+TEST_CASE("testing the ContentionProfiler")
+{
+    SUBCASE("space-saving top-K")
+    {
+        ContentionProfiler profiler(8);
+        profiler.record(1, 0, ContentionEvent::LockWait); // disabled
+        CHECK(profiler.top(4).empty());
+
+        profiler.enable();
+        for (vertex_t i = 0; i < 100; i++)
+        {
+            profiler.record(7, 1, ContentionEvent::WriteWrite);
+            profiler.record(i, 0, ContentionEvent::LockWait);
+            if (i % 2)
+                profiler.record(3, ContentionProfiler::NO_LABEL, ContentionEvent::WaitDie);
+        }
+        auto top = profiler.top(2);
+        REQUIRE(top.size() == 2);
+        CHECK(top[0].vertex_id == 7);
+        CHECK(top[0].label == 1);
+        CHECK(top[0].count == 100);
+        CHECK(top[0].error == 0);
+        CHECK(top[0].events[(size_t)ContentionEvent::WriteWrite] == 100);
+        CHECK(top[1].vertex_id == 3);
+        CHECK(top[1].label == ContentionProfiler::NO_LABEL);
+        CHECK(top[1].count >= 50);
+        CHECK(top[1].count - top[1].error <= 50);
+        CHECK(profiler.top(10).size() == 8);
+
+        profiler.reset();
+        CHECK(profiler.top(4).empty());
+    }
+
+    SUBCASE("graph hotspots")
+    {
+        Graph graph;
+        graph.enable_contention_profiler();
+        {
+            auto txn = graph.begin_transaction();
+            txn.new_vertex();
+            txn.commit();
+        }
+        auto txn1 = graph.begin_transaction();
+        auto txn2 = graph.begin_transaction();
+        txn1.put_vertex(0, "a");
+        CHECK_THROWS_AS(txn2.put_vertex(0, "b"), Transaction::RollbackExcept);
+        txn2.abort();
+        txn1.commit();
+
+        auto hotspots = graph.get_contention_hotspots();
+        REQUIRE(hotspots.size() == 1);
+        CHECK(hotspots[0].vertex_id == 0);
+        CHECK(hotspots[0].events[(size_t)ContentionEvent::LockWait] == 1);
+        CHECK(hotspots[0].events[(size_t)ContentionEvent::WaitDie] == 1);
+    }
+}
@@ -0,0 +1,108 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <doctest/doctest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "core/csr.hpp"
+#include "core/livegraph.hpp"
+
+using namespace livegraph;
+
+TEST_CASE("testing the CSR")
+{
+    Graph graph;
+    const vertex_t num_vertices = 1000;
+    {
+        auto txn = graph.begin_batch_loader();
+        for (vertex_t i = 0; i < num_vertices; i++)
+            txn.new_vertex();
+        for (vertex_t i = 0; i < num_vertices; i++)
+        {
+            for (vertex_t j = 0; j < i % 4; j++)
+            {
+                uint32_t weight = i * 10 + j;
+                txn.put_edge(i, 0, (i * 7 + j) % num_vertices, std::string((char *)&weight, sizeof(weight)));
+                txn.put_edge(i, 1, (i * 3 + j) % num_vertices, std::string(j + 1, 'x'));
+            }
+        }
+        txn.commit();
+    }
+    {
+        auto txn = graph.begin_transaction();
+        txn.del_edge(1, 0, 7);
+        txn.commit();
+    }
+
+    auto txn = graph.begin_read_only_transaction();
+
+    auto check = [&](const CSR &csr, const std::vector<label_t> &labels, bool with_properties) {
+        REQUIRE(csr.get_num_vertices() == num_vertices);
+        for (vertex_t i = 0; i < num_vertices; i++)
+        {
+            auto e = csr.get_offsets()[i];
+            for (auto label : labels)
+            {
+                for (auto iter = txn.get_edges(i, label); iter.valid(); iter.next(), e++)
+                {
+                    CHECK(csr.get_dsts()[e] == iter.dst_id());
+                    if (labels.size() > 1)
+                        CHECK(csr.get_labels()[e] == label);
+                    if (with_properties)
+                        CHECK(csr.get_property(e) == iter.edge_data());
+                }
+            }
+            CHECK(e == csr.get_offsets()[i + 1]);
+        }
+    };
+
+    SUBCASE("in memory with a typed column")
+    {
+        auto csr = txn.materialize_csr({0}, true);
+        CHECK(csr.get_labels() == nullptr);
+        CHECK(csr.get_degree(1) == 0);
+        CHECK(csr.get_degree(2) == 2);
+        auto weights = csr.get_property_column<uint32_t>();
+        REQUIRE(weights != nullptr);
+        CHECK(weights[csr.get_offsets()[3]] == 32); // newest edge first
+        CHECK(csr.get_property_column<uint64_t>() == nullptr);
+        check(csr, {0}, true);
+    }
+
+    SUBCASE("in a file with variable-length properties")
+    {
+        std::string path = "/tmp/livegraph_test_csr.bin";
+        {
+            auto csr = txn.materialize_csr({0, 1}, true, path);
+            check(csr, {0, 1}, true);
+        }
+        auto csr = CSR::open(path);
+        CHECK(csr.get_read_epoch_id() == txn.get_read_epoch_id());
+        CHECK(csr.get_property_column<uint32_t>() == nullptr);
+        check(csr, {0, 1}, true);
+        std::remove(path.c_str());
+    }
+
+    SUBCASE("without properties")
+    {
+        auto csr = txn.materialize_csr({1});
+        CHECK(!csr.has_properties());
+        CHECK(csr.get_property(0).empty());
+        check(csr, {1}, false);
+    }
+}
@@ -0,0 +1,80 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <doctest/doctest.h>
+
+#include <map>
+#include <random>
+
+#include "core/flat_hash_map.hpp"
+#include "core/types.hpp"
+
+using namespace livegraph;
+
+TEST_CASE("testing the FlatHashMap")
+{
+    SUBCASE("compare with std::map")
+    {
+        FlatHashMap<std::pair<vertex_t, label_t>, uintptr_t> map;
+        std::map<std::pair<vertex_t, label_t>, uintptr_t> ref;
+        std::mt19937_64 rng(0);
+        for (size_t i = 0; i < 100000; i++)
+        {
+            auto key = std::make_pair<vertex_t, label_t>(rng() % 10000, rng() % 4);
+            if (rng() % 2)
+            {
+                map[key] = i;
+                ref[key] = i;
+            }
+            else
+            {
+                auto iter = map.find(key);
+                auto ref_iter = ref.find(key);
+                REQUIRE((iter == map.end()) == (ref_iter == ref.end()));
+                if (iter == map.end())
+                {
+                    map.emplace_hint(iter, key, i);
+                    ref.emplace_hint(ref_iter, key, i);
+                }
+                else
+                {
+                    CHECK(iter->second == ref_iter->second);
+                }
+            }
+        }
+        CHECK(map.size() == ref.size());
+        for (const auto &p : map)
+            CHECK(ref.at(p.first) == p.second);
+    }
+
+    SUBCASE("clear keeps capacity")
+    {
+        FlatHashMap<uint64_t, size_t> map;
+        for (uint64_t i = 0; i < 1000; i++)
+            map[i * 64] = i;
+        auto capacity = map.capacity();
+        for (size_t round = 0; round < 3; round++)
+        {
+            map.clear();
+            CHECK(map.empty());
+            CHECK(map.capacity() == capacity);
+            CHECK(map.find(64) == map.end());
+            CHECK(map.emplace(64, round).second);
+            CHECK(!map.emplace(64, 0).second);
+            CHECK(map.find(64)->second == round);
+            CHECK(map.find(128) == map.end());
+        }
+    }
+}
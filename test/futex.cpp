@@ -83,3 +83,66 @@ TEST_CASE("testing the Futex")
         futex.unlock();
     }
 }
+
+TEST_CASE("testing the AdaptiveFutex")
+{
+    SUBCASE("lock and unlock")
+    {
+        const size_t size = 1ul << 15;
+        std::mt19937_64 random;
+        std::vector<uint64_t> data(size);
+        uint64_t sum = 0, min = UINT64_MAX;
+        uint64_t lock_sum = 0, lock_min = UINT64_MAX;
+        AdaptiveFutex mutex;
+
+        mutex.lock();
+        CHECK(!mutex.try_lock());
+        mutex.unlock();
+        CHECK(mutex.try_lock());
+        mutex.clear();
+
+        for (size_t i = 0; i < size; i++)
+        {
+            data[i] = random();
+            sum += data[i];
+            if (min > data[i])
+                min = data[i];
+        }
+
+        #pragma omp parallel for
+        for (size_t i = 0; i < size; i++)
+        {
+            std::lock_guard<AdaptiveFutex> lock(mutex);
+            lock_sum += data[i];
+            if (lock_min > data[i])
+                lock_min = data[i];
+        }
+
+        CHECK(sum == lock_sum);
+        CHECK(min == lock_min);
+    }
+
+    SUBCASE("try_lock_for")
+    {
+        AdaptiveFutex futex;
+        auto num_contended = AdaptiveFutex::get_num_contended();
+        auto num_parked = AdaptiveFutex::get_num_parked();
+        std::thread thread1([&]() {
+            futex.lock();
+            std::this_thread::sleep_for(std::chrono::seconds(2));
+            futex.unlock();
+        });
+        std::thread thread2([&]() {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            CHECK(!futex.try_lock_for(std::chrono::milliseconds(1)));
+            CHECK(futex.try_lock_for(std::chrono::seconds(2)));
+            futex.unlock();
+        });
+        thread1.join();
+        thread2.join();
+        futex.lock();
+        futex.unlock();
+        CHECK(AdaptiveFutex::get_num_contended() >= num_contended + 2);
+        CHECK(AdaptiveFutex::get_num_parked() >= num_parked + 2);
+    }
+}
@@ -0,0 +1,108 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <doctest/doctest.h>
+
+#include <cctype>
+#include <random>
+#include <string>
+
+#include "core/hex.hpp"
+#include "core/livegraph.hpp"
+
+using namespace livegraph;
+
+TEST_CASE("testing the Hex")
+{
+    std::mt19937_64 rng(0);
+    const std::string digits = "0123456789abcdef";
+
+    // Sizes around the 16-character and 16-byte vector widths
+    for (size_t size = 0; size <= 40; size++)
+    {
+        std::string bytes(size, 0), expected;
+        for (auto &byte : bytes)
+        {
+            byte = (char)rng();
+            expected += digits[(unsigned char)byte >> 4];
+            expected += digits[(unsigned char)byte & 0x0f];
+        }
+        CHECK(Hex::encode(bytes, false) == expected);
+        CHECK(Hex::encode(bytes) == "0x" + expected);
+
+        std::string upper = expected, decoded(size, 0);
+        for (auto &c : upper)
+            c = std::toupper(c);
+        for (auto text : {expected, "0x" + expected, "0X" + upper, upper})
+        {
+            REQUIRE(Hex::decode(text, decoded.data(), size));
+            CHECK(decoded == bytes);
+        }
+
+        CHECK_FALSE(Hex::decode(expected + "0", decoded.data(), size));
+        CHECK_FALSE(Hex::decode("0x" + expected + "00", decoded.data(), size));
+        // Every character next to the accepted ranges, at every position
+        for (size_t i = 0; i < expected.size(); i++)
+        {
+            for (char c : {'/', ':', '@', 'G', '`', 'g', ' ', '\0', '\x80', '\xb0'})
+            {
+                auto text = expected;
+                text[i] = c;
+                CHECK_FALSE(Hex::decode(text, decoded.data(), size));
+            }
+        }
+    }
+
+    SUBCASE("FixedKey")
+    {
+        auto text = "0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed";
+        auto address = Address::from_hex(text);
+        CHECK(address.to_hex() == "0x5aaeb6053f3e94c9b9a09f33669435e7ef1beaed");
+        CHECK(Address::from_hex(address.to_hex(false)) == address);
+        CHECK(Address::from_bytes(address.view()) == address);
+        CHECK(address.view().size() == 20);
+        CHECK_THROWS_AS(Address::from_hex("0x5aaeb6"), std::invalid_argument);
+        CHECK_THROWS_AS(Digest::from_bytes(address.view()), std::invalid_argument);
+        CHECK(Digest::from_hex(std::string(64, 'f')).view() == std::string(32, '\xff'));
+    }
+
+    SUBCASE("binary external keys")
+    {
+        GraphOptions options;
+        options.max_keys = 1000;
+        Graph graph("", "", 1ul << 30, 1ul << 20, options);
+        auto txn = graph.begin_transaction();
+        std::vector<std::pair<Address, vertex_t>> vertices;
+        for (size_t i = 0; i < 100; i++)
+        {
+            Address address;
+            for (auto &byte : address.bytes)
+                byte = (char)rng();
+            auto [vertex, created] = txn.find_or_create_vertex(address.view());
+            CHECK(created);
+            txn.put_vertex(vertex, address.view());
+            vertices.emplace_back(address, vertex);
+        }
+        txn.commit();
+
+        auto reader = graph.begin_read_only_transaction();
+        for (auto [address, vertex] : vertices)
+        {
+            CHECK(reader.find_vertex(Address::from_hex(address.to_hex()).view()) == vertex);
+            CHECK(Address::from_bytes(reader.get_vertex_key(vertex)) == address);
+            CHECK(Address::from_bytes(reader.get_vertex(vertex)) == address);
+        }
+    }
+}
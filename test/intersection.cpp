@@ -0,0 +1,55 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "core/intersection.hpp"
+
+using namespace livegraph;
+
+TEST_CASE("testing the SortedIntersection")
+{
+    std::mt19937_64 rng(0);
+    auto random_set = [&](size_t size, vertex_t range) {
+        std::set<vertex_t> set;
+        while (set.size() < size)
+            set.insert(rng() % range);
+        return std::vector<vertex_t>(set.begin(), set.end());
+    };
+
+    // Balanced sizes take the merge path, skewed ones the galloping path
+    for (auto [na, nb] : {std::pair<size_t, size_t>{0, 10}, {7, 9}, {100, 120}, {1000, 1000}, {5, 5000}, {64, 10000}})
+    {
+        auto a = random_set(na, 2 * (na + nb));
+        auto b = random_set(nb, 2 * (na + nb));
+        std::vector<vertex_t> expected;
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+
+        std::vector<vertex_t> out(std::min(na, nb));
+        auto count = SortedIntersection::intersect(a.data(), na, b.data(), nb, out.data());
+        out.resize(count);
+        CHECK(out == expected);
+        CHECK(SortedIntersection::intersect(b.data(), nb, a.data(), na) == expected.size());
+    }
+
+    std::vector<vertex_t> same = random_set(1000, 1ul << 40);
+    CHECK(SortedIntersection::intersect(same.data(), same.size(), same.data(), same.size()) == same.size());
+}
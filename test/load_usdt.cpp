@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdio>
 #include <map>
 #include <mutex>
@@ -22,8 +23,6 @@ using namespace std;
 using namespace livegraph;
 
 label_t label = 1;
-unordered_map<string,vertex_t> add2id;
-unordered_map<vertex_t,string> id2add;
 vertex_t max_vertex_id = 0;
 int vertex_num = 0;
 int edge_num = 0;
@@ -116,11 +115,12 @@ void load_vertex(string path, Graph& g) {
     int count = 0;
     while (std::getline(file, line)) {
         // vertices.push_back(line);
-        vertex_t id = t.new_vertex();
+        // 地址以 20 字节二进制形式作为主键和顶点属性
+        auto address = Address::from_hex(line);
+        auto [id, created] = t.find_or_create_vertex(address.view());
         max_vertex_id = id;
-        add2id[line] = id;
-        id2add[id] = line;
-        t.put_vertex(id, line);
+        if (created)
+            t.put_vertex(id, address.view());
         count += 1;
         if (count % 10000 == 0) {
             updateProgressBar(count, line_count, 80);
@@ -147,7 +147,7 @@ void load_edge(string path, Graph& g) {
     // std::vector<edge> edges;
     std::ifstream file(path);
     std::string line;
-    int count = 0;
+    int count = 0, skipped = 0;
     // 开启事务
     // Transaction t = g.begin_transaction();
     Transaction t = g.begin_batch_loader();
@@ -159,16 +159,26 @@ void load_edge(string path, Graph& g) {
         std::getline(ss, to_account, ',');
         ss >> block_number;
         // 不带版本
-        // t.put_edge(add2id[from_account], label, add2id[to_account], std::to_string(block_number));
+        // t.put_edge(t.find_vertex(from_account), label, t.find_vertex(to_account), std::to_string(block_number));
         // 带版本
-        t.put_edge_with_version(add2id[from_account], label, add2id[to_account], std::to_string(block_number), block_number);
-        count += 1;
-        if (count % 10000 == 0) {
-            updateProgressBar(count, line_count, 80);
+        auto src = t.find_vertex(Address::from_hex(from_account).view());
+        auto dst = t.find_vertex(Address::from_hex(to_account).view());
+        // 顶点文件中没有的账户，跳过这条边
+        if (src == Transaction::NO_VERTEX || dst == Transaction::NO_VERTEX) {
+            skipped += 1;
+        } else {
+            t.put_edge_with_version(src, label, dst, std::to_string(block_number), block_number);
+            count += 1;
+        }
+        if ((count + skipped) % 10000 == 0) {
+            updateProgressBar(count + skipped, line_count, 80);
         }
     }
-    updateProgressBar(count, line_count, 80);
+    updateProgressBar(count + skipped, line_count, 80);
     std::cout << std::endl;
+    if (skipped > 0) {
+        std::cout << "skipped " << skipped << " edges with unknown accounts" << std::endl;
+    }
     // std::cout << "ready to commit" << std::endl;
     timestamp_t commit_time = t.commit();
     // std::cout << "commit time: " << commit_time << std::endl;
@@ -214,7 +224,7 @@ void query2(Graph& g, vertex_t vertex_id) {
 bfs_result k_hop_bfs(Transaction& t, int k, vertex_t target, timestamp_t start, timestamp_t end, int& count) {
     float query_time = 0;
     float resolve_time = 0;
-    // std::cout << "processing " << k << "-hop query for " << id2add[target] << std::endl;
+    // std::cout << "processing " << k << "-hop query for " << Hex::encode(t.get_vertex_key(target)) << std::endl;
     std::queue<query> khop_queue;
     std::unordered_set<vertex_t> visit;
 
@@ -240,7 +250,7 @@ bfs_result k_hop_bfs(Transaction& t, int k, vertex_t target, timestamp_t start,
             vertex_t dst = edge_iter.dst_id();
             timestamp_t version = edge_iter.version();
             std::string_view data=edge_iter.edge_data();
-            // cout<< id2add[target] << "," << id2add[dst] << "," << version << endl;
+            // cout<< Hex::encode(t.get_vertex_key(target)) << "," << Hex::encode(t.get_vertex_key(dst)) << "," << version << endl;
             // 这边的count += 1 的位置可能有点问题
             count += 1;
             sub_count += 1;
@@ -264,7 +274,7 @@ bfs_result k_hop_bfs(Transaction& t, int k, vertex_t target, timestamp_t start,
         auto end_time_resolve = std::chrono::high_resolution_clock::now();
         std::chrono::duration<float, std::milli> duration_resolve = end_time_resolve - end_time_query;
         resolve_time += duration_resolve.count();
-        // std::cout << "1-hop for " << id2add[tmp_target] << ": " << sub_count << std::endl;
+        // std::cout << "1-hop for " << Hex::encode(t.get_vertex_key(tmp_target)) << ": " << sub_count << std::endl;
     }
     return bfs_result(query_time, resolve_time);
 }
@@ -312,7 +322,8 @@ void file_test(Graph& g, string input_path, string output_path, int k) {
         getline(ss, item, ',');
         end_version = timestamp_t(stoi(item));
 
-        std::pair<query_result, bfs_result> res = k_hop_query(g, k, add2id[target], start_version, end_version);
+        vertex_t target_id = g.begin_read_only_transaction().find_vertex(Address::from_hex(target).view());
+        std::pair<query_result, bfs_result> res = k_hop_query(g, k, target_id, start_version, end_version);
 
         int count = res.first.getCount();
         float elapsed_time = res.first.getElapsedTime();
@@ -358,9 +369,13 @@ std::string getCurrentTimestampAsString() {
 
 
 int main(){
-    Graph g = Graph("/home/lys/LiveGraph/block_path","/home/lys/LiveGraph/wal_path");
     std::string file_path = "/home/lys/LiveGraph/data/";
     std::string file_name = "usdt_1200_1700";
+    // 地址到顶点的映射由图内置的主键索引维护
+    size_t max_keys = std::max(getFileLineCount(file_path + file_name + "_vertex.txt"), 1);
+    GraphOptions options;
+    options.max_keys = max_keys;
+    Graph g("/home/lys/LiveGraph/block_path", "/home/lys/LiveGraph/wal_path", 1ul << 40, 1ul << 40, options);
     // load_vertex("/home/lys/LiveGraph/data/usdt_1600_1700_vertex.txt", g);
     // load_edge("/home/lys/LiveGraph/data/usdt_1600_1700_edge.txt", g);
     load_vertex(file_path + file_name + "_vertex.txt", g);
@@ -0,0 +1,77 @@
+/* Copyright 2020 Guanyu Feng, Tsinghua University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "core/livegraph.hpp"
+#include "core/reader_registry.hpp"
+
+using namespace livegraph;
+
+TEST_CASE("testing the ReaderRegistry")
+{
+    const timestamp_t idle = -1;
+
+    SUBCASE("slots are padded and reused")
+    {
+        CHECK(sizeof(ReaderRegistry::Slot) == 64);
+
+        auto registry = std::make_shared<ReaderRegistry>(2, idle);
+        {
+            ReaderHandle h1(registry), h2(registry);
+            CHECK(&h1.get_read_epoch_id() != &h2.get_read_epoch_id());
+            h1.get_read_epoch_id() = 10;
+            h2.get_read_epoch_id() = 5;
+            timestamp_t min_epoch = INT64_MAX;
+            registry->for_each([&](timestamp_t id) { min_epoch = std::min(min_epoch, id); });
+            CHECK(min_epoch == 5);
+            CHECK_THROWS_AS(ReaderHandle(registry), std::runtime_error);
+        }
+        ReaderHandle h3(registry);
+        CHECK(h3.get_read_epoch_id() == idle);
+        CHECK(!h3.is_orphan());
+        registry.reset();
+        CHECK(h3.is_orphan());
+    }
+
+    SUBCASE("compaction sees readers of other threads")
+    {
+        Graph graph;
+        {
+            auto txn = graph.begin_transaction();
+            txn.new_vertex();
+            txn.commit();
+        }
+        auto reader = graph.begin_read_only_transaction();
+        auto read_epoch_id = reader.get_read_epoch_id();
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < 4; i++)
+        {
+            threads.emplace_back([&]() {
+                auto txn = graph.begin_transaction();
+                txn.put_vertex(0, "data");
+                txn.commit();
+            });
+            threads.back().join();
+        }
+        CHECK(graph.compact() == read_epoch_id);
+        reader.abort();
+        CHECK(graph.compact() > read_epoch_id);
+    }
+}
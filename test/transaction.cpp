@@ -15,7 +15,18 @@
 
 #include <doctest/doctest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <set>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <vector>
 
 #include "core/livegraph.hpp"
@@ -473,3 +484,1489 @@ TEST_CASE("testing the Transaction: put/get/del_edge")
         CHECK_THROWS_AS(txn.get_edge(0, 0, 1), std::invalid_argument);
     }
 }
+
+TEST_CASE("testing the Transaction: fine-grained edge locking")
+{
+    GraphOptions options;
+    options.fine_grained_edge_lock = true;
+    Graph graph("", "", 1ul << 30, 1ul << 20, options);
+
+    {
+        auto txn = graph.begin_transaction();
+        for (vertex_t i = 0; i < 4; i++)
+            CHECK(txn.new_vertex() == i);
+        txn.put_vertex(0, "v0");
+        txn.put_edge(0, 0, 1, "0-0->1");
+        txn.put_edge(0, 1, 1, "0-1->1");
+        txn.commit();
+    }
+    { // Different labels of the same vertex do not conflict
+        auto txn1 = graph.begin_transaction();
+        auto txn2 = graph.begin_transaction();
+        auto txn3 = graph.begin_transaction();
+        txn1.put_edge(0, 0, 2, "0-0->2");
+        txn2.put_edge(0, 1, 2, "0-1->2");
+        txn3.put_vertex(0, "v0'");
+        CHECK_THROWS_AS(txn2.put_edge(0, 0, 3, "0-0->3"), Transaction::RollbackExcept);
+        txn1.commit();
+        txn2.commit();
+        txn3.commit();
+    }
+    {
+        auto txn = graph.begin_read_only_transaction();
+        CHECK(txn.get_vertex(0) == "v0'");
+        CHECK(txn.get_edge(0, 0, 2) == "0-0->2");
+        CHECK(txn.get_edge(0, 1, 2) == "0-1->2");
+        CHECK(txn.get_edge(0, 0, 3) == "");
+    }
+    { // A new label changes the label directory and needs the vertex lock
+        auto txn1 = graph.begin_transaction();
+        auto txn2 = graph.begin_transaction();
+        txn1.put_edge(0, 2, 1, "0-2->1");
+        CHECK_THROWS_AS(txn2.put_edge(0, 3, 1, "0-3->1"), Transaction::RollbackExcept);
+        CHECK_THROWS_AS(txn2.put_vertex(0, "v0''"), Transaction::RollbackExcept);
+        txn1.commit();
+    }
+    {
+        auto txn = graph.begin_batch_loader();
+        txn.put_edge(0, 3, 1, "0-3->1");
+        CHECK(!txn.del_edge(1, 3, 0));
+        CHECK(txn.del_edge(0, 3, 1));
+    }
+    graph.compact();
+    {
+        auto txn = graph.begin_read_only_transaction();
+        CHECK(txn.get_edge(0, 0, 1) == "0-0->1");
+        CHECK(txn.get_edge(0, 1, 1) == "0-1->1");
+        CHECK(txn.get_edge(0, 2, 1) == "0-2->1");
+        CHECK(txn.get_edge(0, 3, 1) == "");
+    }
+}
+
+TEST_CASE("testing the Transaction: wait-die")
+{
+    Graph graph;
+
+    {
+        auto txn = graph.begin_transaction();
+        for (vertex_t i = 0; i < 2; i++)
+            CHECK(txn.new_vertex() == i);
+        txn.commit();
+    }
+    { // A younger transaction dies at once
+        auto txn1 = graph.begin_transaction();
+        auto txn2 = graph.begin_transaction();
+        CHECK(txn1.get_priority() < txn2.get_priority());
+        txn1.put_vertex(0, "aaaa");
+        auto stats = graph.get_transaction_stats();
+        CHECK_THROWS_AS(txn2.put_vertex(0, "bbbb"), Transaction::RollbackExcept);
+        CHECK(graph.get_transaction_stats().num_wait_die_rollbacks == stats.num_wait_die_rollbacks + 1);
+        txn1.commit();
+    }
+    { // An older transaction waits for a younger one
+        auto txn1 = graph.begin_transaction();
+        auto txn2 = graph.begin_transaction();
+        txn2.put_vertex(1, "bbbb");
+        std::thread thread([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            txn2.commit();
+        });
+        txn1.put_edge(1, 0, 0, "1->0");
+        thread.join();
+        CHECK_THROWS_AS(txn1.put_vertex(1, "aaaa"), Transaction::RollbackExcept); // written after the read epoch
+        CHECK(graph.get_transaction_stats().num_write_write_rollbacks > 0);
+    }
+    { // A retried transaction keeps its priority
+        auto txn1 = graph.begin_transaction();
+        auto priority = txn1.get_priority();
+        txn1.abort();
+        auto txn2 = graph.begin_transaction();
+        auto txn3 = graph.begin_transaction(priority);
+        CHECK(txn3.get_priority() == priority);
+        txn2.put_vertex(0, "cccc");
+        std::thread thread([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            txn2.commit();
+        });
+        CHECK_THROWS_AS(txn3.put_vertex(0, "dddd"), Transaction::RollbackExcept); // waited, then saw the new version
+        thread.join();
+    }
+}
+
+TEST_CASE("testing the Transaction: execute with retry")
+{
+    Graph graph;
+
+    graph.execute([](Transaction &txn) {
+        auto vid = txn.new_vertex();
+        txn.put_vertex(vid, std::to_string(0));
+    });
+
+    const size_t num_threads = 4, num_increments = 200;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; i++)
+    {
+        threads.emplace_back([&]() {
+            ExecuteOptions options;
+            options.max_retries = SIZE_MAX;
+            for (size_t j = 0; j < num_increments; j++)
+            {
+                graph.execute(
+                    [](Transaction &txn) {
+                        auto value = std::stoul(std::string(txn.get_vertex(0)));
+                        txn.put_vertex(0, std::to_string(value + 1));
+                    },
+                    options);
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    auto value = graph.execute([](Transaction &txn) { return std::string(txn.get_vertex(0)); });
+    CHECK(value == std::to_string(num_threads * num_increments));
+
+    auto stats = graph.get_transaction_stats();
+    CHECK(stats.num_executions == num_threads * num_increments + 2);
+    CHECK(stats.num_execute_exhausted == 0);
+    CHECK(stats.num_execute_retries ==
+          stats.num_wait_die_rollbacks + stats.num_lock_timeout_rollbacks + stats.num_write_write_rollbacks);
+
+    { // The retry budget is capped
+        auto txn = graph.begin_transaction();
+        txn.put_vertex(0, "locked");
+        ExecuteOptions options;
+        options.max_retries = 2;
+        CHECK_THROWS_AS(graph.execute([](Transaction &txn) { txn.put_vertex(0, "aaaa"); }, options),
+                        Transaction::RollbackExcept);
+        CHECK(graph.get_transaction_stats().num_execute_exhausted == 1);
+        txn.abort();
+    }
+}
+
+TEST_CASE("testing the Transaction: serializable")
+{
+    Graph graph;
+
+    {
+        auto txn = graph.begin_transaction();
+        for (vertex_t i = 0; i < 2; i++)
+        {
+            CHECK(txn.new_vertex() == i);
+            txn.put_vertex(i, "1");
+        }
+        txn.put_edge(0, 0, 1, "0->1");
+        txn.commit();
+    }
+
+    // On-call rule: vertex 0 or vertex 1 must stay "1".
+    auto go_off_call = [](Transaction &txn, vertex_t self) {
+        if (txn.get_vertex(0) == "1" && txn.get_vertex(1) == "1")
+            txn.put_vertex(self, "0");
+    };
+
+    { // Snapshot isolation allows write skew
+        auto txn1 = graph.begin_transaction();
+        auto txn2 = graph.begin_transaction();
+        go_off_call(txn1, 0);
+        go_off_call(txn2, 1);
+        txn2.commit();
+        txn1.commit();
+        auto txn = graph.begin_read_only_transaction();
+        CHECK(txn.get_vertex(0) == "0");
+        CHECK(txn.get_vertex(1) == "0");
+    }
+    {
+        auto txn = graph.begin_transaction();
+        txn.put_vertex(0, "1");
+        txn.put_vertex(1, "1");
+        txn.commit();
+    }
+    { // Serializable mode rejects it
+        auto txn1 = graph.begin_serializable_transaction();
+        auto txn2 = graph.begin_serializable_transaction();
+        go_off_call(txn1, 0);
+        go_off_call(txn2, 1);
+        CHECK_THROWS_AS(txn2.commit(), Transaction::RollbackExcept);
+        txn2.abort();
+        txn1.commit();
+        auto txn = graph.begin_read_only_transaction();
+        CHECK(txn.get_vertex(0) == "0");
+        CHECK(txn.get_vertex(1) == "1");
+    }
+    { // A read overwritten by a committed transaction
+        auto stats = graph.get_transaction_stats();
+        auto txn1 = graph.begin_serializable_transaction();
+        CHECK(txn1.get_edge(0, 0, 1) == "0->1");
+        {
+            auto txn2 = graph.begin_transaction();
+            txn2.del_edge(0, 0, 1);
+            txn2.commit();
+        }
+        txn1.put_vertex(1, "2");
+        CHECK_THROWS_AS(txn1.commit(), Transaction::RollbackExcept);
+        CHECK(graph.get_transaction_stats().num_read_write_rollbacks == stats.num_read_write_rollbacks + 1);
+    }
+    { // Reads of own writes are not validated
+        auto txn1 = graph.begin_serializable_transaction();
+        txn1.put_edge(0, 1, 0, "1->0");
+        CHECK(txn1.get_edge(0, 1, 0) == "1->0");
+        txn1.commit();
+    }
+
+    // Rule: at least one label 2 edge must stay; the edges have different sources, so only a scan sees both.
+    {
+        auto txn = graph.begin_transaction();
+        txn.put_edge(0, 2, 1, "0->1");
+        txn.put_edge(1, 2, 0, "1->0");
+        txn.commit();
+    }
+    auto count_edges = [](Transaction &txn) {
+        std::atomic<size_t> count(0);
+        txn.for_each_edge(2, [&](vertex_t, vertex_t, std::string_view) { count++; });
+        return count.load();
+    };
+    auto drop_edge = [&](Transaction &txn, vertex_t src) {
+        if (count_edges(txn) > 1)
+            txn.del_edge(src, 2, 1 - src);
+    };
+    { // Write skew through for_each_edge
+        auto txn1 = graph.begin_serializable_transaction();
+        auto txn2 = graph.begin_serializable_transaction();
+        drop_edge(txn1, 0);
+        drop_edge(txn2, 1);
+        CHECK_THROWS_AS(txn2.commit(), Transaction::RollbackExcept);
+        txn2.abort();
+        txn1.commit();
+        auto txn = graph.begin_read_only_transaction();
+        CHECK(count_edges(txn) == 1);
+        CHECK(txn.get_edge(1, 2, 0) == "1->0");
+    }
+    { // An edge list scanned, then changed by a committed transaction
+        auto stats = graph.get_transaction_stats();
+        auto txn1 = graph.begin_serializable_transaction();
+        CHECK(count_edges(txn1) == 1);
+        {
+            auto txn2 = graph.begin_transaction();
+            txn2.put_edge(0, 2, 1, "0->1");
+            txn2.commit();
+        }
+        txn1.put_vertex(0, "2");
+        CHECK_THROWS_AS(txn1.commit(), Transaction::RollbackExcept);
+        CHECK(graph.get_transaction_stats().num_read_write_rollbacks == stats.num_read_write_rollbacks + 1);
+    }
+    { // A vertex created after a vertex scan
+        auto txn1 = graph.begin_serializable_transaction();
+        std::atomic<size_t> num_vertices(0);
+        txn1.for_each_vertex([&](vertex_t, std::string_view) { num_vertices++; });
+        CHECK(num_vertices == 2);
+        {
+            auto txn2 = graph.begin_transaction();
+            txn2.put_vertex(txn2.new_vertex(), "1");
+            txn2.commit();
+        }
+        txn1.put_vertex(0, "2");
+        CHECK_THROWS_AS(txn1.commit(), Transaction::RollbackExcept);
+    }
+    { // Scans without concurrent writes commit
+        auto txn1 = graph.begin_serializable_transaction();
+        CHECK(count_edges(txn1) == 2);
+        txn1.put_vertex(0, "2");
+        txn1.commit();
+    }
+}
+
+TEST_CASE("testing the Transaction: batched vertex id allocation")
+{
+    const vertex_t batch_size = 16;
+    GraphOptions options;
+    options.vertex_id_batch_size = batch_size;
+    Graph graph("", "", 1ul << 30, 1ul << 20, options);
+
+    { // Ids of one thread are consecutive within a reserved range
+        auto txn = graph.begin_transaction();
+        for (vertex_t i = 0; i < batch_size + 1; i++)
+            CHECK(txn.new_vertex() == i);
+        CHECK(graph.get_max_vertex_id() == 2 * batch_size);
+        txn.commit();
+    }
+
+    const size_t num_threads = 4, num_vertices = 1000;
+    std::vector<std::vector<vertex_t>> ids(num_threads);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++)
+    {
+        threads.emplace_back([&, t]() {
+            for (size_t i = 0; i < num_vertices; i++)
+            {
+                auto txn = graph.begin_transaction();
+                auto vid = txn.new_vertex(true);
+                txn.put_vertex(vid, std::to_string(t));
+                txn.commit();
+                ids[t].push_back(vid);
+                if (i % 2)
+                {
+                    auto txn = graph.begin_transaction();
+                    txn.del_vertex(vid, true);
+                    txn.commit();
+                }
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    auto txn = graph.begin_read_only_transaction();
+    std::set<vertex_t> live;
+    for (size_t t = 0; t < num_threads; t++)
+    {
+        for (size_t i = 0; i < num_vertices; i += 2)
+        {
+            // an id is only reused after it was deleted, so every live id is unique
+            CHECK(live.insert(ids[t][i]).second);
+            CHECK(txn.get_vertex(ids[t][i]) == std::to_string(t));
+        }
+    }
+    CHECK(graph.get_max_vertex_id() < num_threads * num_vertices);
+}
+
+TEST_CASE("testing the Transaction: parallel scan")
+{
+    Graph graph;
+    const vertex_t num_vertices = 10000;
+    const label_t num_labels = 3;
+
+    {
+        auto txn = graph.begin_batch_loader();
+        for (vertex_t i = 0; i < num_vertices; i++)
+            txn.new_vertex();
+        for (vertex_t i = 0; i < num_vertices; i++)
+        {
+            if (i % 7)
+                txn.put_vertex(i, std::to_string(i));
+            for (vertex_t j = 0; j < i % 5; j++)
+                txn.put_edge(i, i % num_labels, (i + j) % num_vertices, std::to_string(j));
+        }
+        txn.commit();
+    }
+    {
+        auto txn = graph.begin_transaction();
+        txn.del_vertex(1);
+        txn.del_edge(4, 1, 5);
+        txn.commit();
+    }
+
+    auto txn = graph.begin_transaction();
+    txn.put_vertex(0, "new");
+    txn.put_edge(0, 0, 1, "new");
+
+    std::mutex mutex;
+    std::map<vertex_t, std::string> vertices;
+    txn.for_each_vertex([&](vertex_t vid, std::string_view data) {
+        std::lock_guard<std::mutex> lock(mutex);
+        CHECK(vertices.emplace(vid, std::string(data)).second);
+    });
+    std::map<vertex_t, std::string> expected_vertices;
+    for (vertex_t i = 0; i < num_vertices; i++)
+    {
+        auto data = txn.get_vertex(i);
+        if (data.size())
+            expected_vertices.emplace(i, std::string(data));
+    }
+    CHECK(vertices == expected_vertices);
+    CHECK(vertices.at(0) == "new");
+    CHECK(!vertices.count(1));
+    CHECK(!vertices.count(7));
+
+    for (label_t label = 0; label < num_labels; label++)
+    {
+        std::vector<std::tuple<vertex_t, vertex_t, std::string>> edges, expected_edges;
+        txn.for_each_edge(
+            label,
+            [&](vertex_t src, vertex_t dst, std::string_view data) {
+                std::lock_guard<std::mutex> lock(mutex);
+                edges.emplace_back(src, dst, std::string(data));
+            },
+            64);
+        for (vertex_t i = 0; i < num_vertices; i++)
+        {
+            for (auto iter = txn.get_edges(i, label); iter.valid(); iter.next())
+                expected_edges.emplace_back(i, iter.dst_id(), std::string(iter.edge_data()));
+        }
+        std::sort(edges.begin(), edges.end());
+        std::sort(expected_edges.begin(), expected_edges.end());
+        CHECK(edges == expected_edges);
+    }
+    txn.abort();
+}
+
+TEST_CASE("testing the Transaction: sample_neighbors")
+{
+    Graph graph;
+    const vertex_t degree = 20;
+    {
+        auto txn = graph.begin_transaction();
+        for (vertex_t i = 0; i <= degree; i++)
+            txn.new_vertex();
+        for (vertex_t i = 1; i <= degree; i++)
+            txn.put_edge(0, 0, i, std::string(1, (char)(i <= 2 ? 0 : i <= 4 ? 9 : 1)));
+        txn.put_edge(1, 0, 2, std::string(1, 1));
+        txn.commit();
+    }
+    {
+        auto txn = graph.begin_transaction();
+        txn.del_edge(0, 0, degree);
+        txn.commit();
+    }
+    // Uncommitted, so invisible to the others
+    auto writer = graph.begin_transaction();
+    writer.put_edge(0, 0, 1, std::string(1, 100));
+
+    std::mt19937_64 rng(0);
+    vertex_t out[degree];
+    auto txn = graph.begin_read_only_transaction();
+
+    SUBCASE("uniform")
+    {
+        std::map<vertex_t, size_t> histogram;
+        const size_t k = 5, rounds = 20000;
+        for (size_t round = 0; round < rounds; round++)
+        {
+            REQUIRE(txn.sample_neighbors(0, 0, k, rng, out) == k);
+            std::set<vertex_t> distinct(out, out + k);
+            CHECK(distinct.size() == k);
+            for (size_t i = 0; i < k; i++)
+                histogram[out[i]]++;
+        }
+        CHECK(histogram.size() == degree - 1);
+        CHECK(histogram.count(degree) == 0);
+        for (auto [dst, count] : histogram)
+            CHECK(count == doctest::Approx((double)rounds * k / (degree - 1)).epsilon(0.1));
+
+        CHECK(txn.sample_neighbors(0, 0, 100, rng, out) == degree - 1);
+        CHECK(txn.sample_neighbors(0, 1, 3, rng, out) == 0);
+        CHECK(txn.sample_neighbors(0, 0, 0, rng, out) == 0);
+
+        CHECK(writer.sample_neighbors(0, 0, 100, rng, out) == degree - 1);
+    }
+
+    SUBCASE("weighted")
+    {
+        auto weight = [](std::string_view data) { return (double)data[0]; };
+        std::map<vertex_t, size_t> histogram;
+        const size_t rounds = 20000;
+        for (size_t round = 0; round < rounds; round++)
+        {
+            REQUIRE(txn.sample_neighbors(0, 0, 1, rng, out, weight) == 1);
+            histogram[out[0]]++;
+        }
+        // 1 and 2 have weight 0, 3 and 4 weight 9, the other 15 visible edges weight 1
+        CHECK(histogram.count(1) == 0);
+        CHECK(histogram.count(2) == 0);
+        CHECK(histogram[3] == doctest::Approx(rounds * 9.0 / 33).epsilon(0.1));
+        CHECK(histogram[5] == doctest::Approx(rounds * 1.0 / 33).epsilon(0.2));
+        CHECK(txn.sample_neighbors(0, 0, 100, rng, out, weight) == degree - 3);
+    }
+
+    SUBCASE("batch")
+    {
+        vertex_t srcs[] = {0, 1, 2, 0};
+        vertex_t batch_out[4 * 3];
+        size_t counts[4];
+        txn.sample_neighbors_batch(srcs, 4, 0, 3, rng, batch_out, counts);
+        CHECK(counts[0] == 3);
+        CHECK(counts[1] == 1);
+        CHECK(batch_out[3] == 2);
+        CHECK(counts[2] == 0);
+        CHECK(counts[3] == 3);
+    }
+
+    writer.abort();
+}
+
+TEST_CASE("testing the Transaction: sorted edge blocks and triangle counting")
+{
+    const vertex_t num_vertices = 500;
+    const size_t num_edges = 4000;
+    std::mt19937_64 rng(0);
+    std::set<std::pair<vertex_t, vertex_t>> edges;
+    while (edges.size() < num_edges)
+    {
+        vertex_t u = rng() % num_vertices, v = rng() % num_vertices;
+        if (u != v)
+            edges.emplace(std::min(u, v), std::max(u, v));
+    }
+    std::vector<std::pair<vertex_t, vertex_t>> shuffled(edges.begin(), edges.end());
+    std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+    std::vector<std::set<vertex_t>> adjacency(num_vertices);
+    for (auto [u, v] : edges)
+    {
+        adjacency[u].insert(v);
+        adjacency[v].insert(u);
+    }
+    size_t expected_triangles = 0;
+    for (auto [u, v] : edges)
+        for (auto w : adjacency[u])
+            expected_triangles += w > v && adjacency[v].count(w);
+
+    auto is_sorted = [](Transaction &txn, vertex_t src) {
+        std::vector<vertex_t> dsts;
+        for (auto iter = txn.get_edges(src, 0, true); iter.valid(); iter.next())
+            dsts.push_back(iter.dst_id());
+        return std::is_sorted(dsts.begin(), dsts.end());
+    };
+
+    for (bool sort_edge_blocks : {false, true})
+    {
+        GraphOptions options;
+        options.sort_edge_blocks = sort_edge_blocks;
+        Graph graph("", "", 1ul << 30, 1ul << 20, options);
+        {
+            auto txn = graph.begin_batch_loader();
+            for (vertex_t i = 0; i < num_vertices; i++)
+                txn.new_vertex();
+            for (auto [u, v] : shuffled)
+            {
+                txn.put_edge(u, 0, v, "u");
+                txn.put_edge(v, 0, u, "v");
+            }
+            txn.commit();
+        }
+        {
+            auto txn = graph.begin_read_only_transaction();
+            CHECK(txn.count_triangles(0, 64) == expected_triangles);
+            size_t num_sorted = 0;
+            for (vertex_t v = 0; v < num_vertices; v++)
+                num_sorted += is_sorted(txn, v);
+            if (sort_edge_blocks)
+                CHECK(num_sorted == num_vertices);
+            else
+                CHECK(num_sorted < num_vertices);
+        }
+
+        // Deletions and appends after the sort leave an unsorted tail until the next compaction
+        auto [a, b] = shuffled[0];
+        {
+            auto txn = graph.begin_transaction();
+            txn.del_edge(a, 0, b);
+            txn.del_edge(b, 0, a);
+            txn.put_edge(a, 0, 0, "new");
+            txn.put_edge(0, 0, a, "new");
+            txn.commit();
+        }
+        adjacency[a].erase(b);
+        adjacency[b].erase(a);
+        if (a != 0 && !adjacency[a].count(0))
+        {
+            adjacency[a].insert(0);
+            adjacency[0].insert(a);
+        }
+
+        auto check = [&]() {
+            auto txn = graph.begin_read_only_transaction();
+            for (vertex_t u = 0; u < num_vertices; u += 7)
+            {
+                for (vertex_t v = 0; v < num_vertices; v += 11)
+                {
+                    std::vector<vertex_t> expected;
+                    std::set_intersection(adjacency[u].begin(), adjacency[u].end(), adjacency[v].begin(),
+                                          adjacency[v].end(), std::back_inserter(expected));
+                    CHECK(txn.intersect(u, v, 0) == expected);
+                }
+            }
+            CHECK(txn.intersect(a, a, 0) == std::vector<vertex_t>(adjacency[a].begin(), adjacency[a].end()));
+        };
+        check();
+
+        graph.compact();
+        {
+            auto txn = graph.begin_read_only_transaction();
+            CHECK(is_sorted(txn, a) == sort_edge_blocks);
+        }
+        check();
+    }
+
+    // Compaction leaves a short unsorted tail to the readers and sorts a long one
+    {
+        GraphOptions options;
+        options.sort_edge_blocks = true;
+        options.max_unsorted_tail = 8;
+        Graph graph("", "", 1ul << 30, 1ul << 20, options);
+        {
+            auto loader = graph.begin_batch_loader();
+            for (vertex_t i = 0; i < 200; i++)
+                loader.new_vertex();
+            for (vertex_t i = 100; i > 0; i--)
+                loader.put_edge(0, 0, i, "");
+            loader.commit();
+        }
+        auto append = [&](vertex_t first, vertex_t num) {
+            auto txn = graph.begin_transaction();
+            for (vertex_t i = 0; i < num; i++)
+                txn.put_edge(0, 0, first - i, "");
+            txn.commit();
+        };
+        append(110, 5);
+        graph.compact();
+        {
+            auto txn = graph.begin_read_only_transaction();
+            CHECK(!is_sorted(txn, 0));
+            CHECK(txn.intersect(0, 0, 0).size() == 105);
+        }
+        append(199, 10);
+        graph.compact();
+        {
+            auto txn = graph.begin_read_only_transaction();
+            CHECK(is_sorted(txn, 0));
+            CHECK(txn.intersect(0, 0, 0).size() == 115);
+        }
+    }
+
+    // Readers scanning a block while the batch loader sorts it at commit
+    {
+        GraphOptions options;
+        options.sort_edge_blocks = true;
+        Graph graph("", "", 1ul << 30, 1ul << 20, options);
+        const vertex_t num_dsts = 4000;
+        std::vector<vertex_t> dsts(num_dsts);
+        std::iota(dsts.begin(), dsts.end(), 1);
+        std::shuffle(dsts.begin(), dsts.end(), std::mt19937_64(1));
+        {
+            auto loader = graph.begin_batch_loader();
+            for (vertex_t i = 0; i <= num_dsts * 2; i++)
+                loader.new_vertex();
+            for (vertex_t i = 0; i < num_dsts / 2; i++)
+                loader.put_edge(0, 0, dsts[i], std::to_string(dsts[i]));
+            loader.commit();
+        }
+
+        std::atomic<bool> done(false);
+        std::atomic<size_t> num_errors(0), num_scans(0);
+        std::thread reader([&]() {
+            while (!done.load())
+            {
+                auto txn = graph.begin_read_only_transaction();
+                std::set<vertex_t> seen;
+                for (auto iter = txn.get_edges(0, 0); iter.valid(); iter.next())
+                {
+                    if (iter.edge_data() != std::to_string(iter.dst_id()))
+                        num_errors++;
+                    seen.insert(iter.dst_id());
+                }
+                for (vertex_t i = 0; i < num_dsts / 2; i++)
+                {
+                    if (!seen.count(dsts[i]) || txn.get_edge(0, 0, dsts[i]) != std::to_string(dsts[i]))
+                        num_errors++;
+                }
+                num_scans++;
+            }
+        });
+        for (vertex_t round = 0; round < 20; round++)
+        {
+            auto loader = graph.begin_batch_loader();
+            for (vertex_t i = 0; i < 100; i++)
+            {
+                auto dst = num_dsts + 1 + round * 100 + (i * 37) % 100;
+                loader.put_edge(0, 0, dst, std::to_string(dst));
+            }
+            loader.commit();
+        }
+        while (num_scans.load() < 10)
+            std::this_thread::yield();
+        done = true;
+        reader.join();
+        CHECK(num_errors.load() == 0);
+
+        auto txn = graph.begin_read_only_transaction();
+        CHECK(is_sorted(txn, 0));
+    }
+}
+
+TEST_CASE("testing the Transaction: pattern matching")
+{
+    const vertex_t num_vertices = 200;
+    const size_t num_edges = 2000;
+    Graph graph;
+    std::set<std::tuple<vertex_t, vertex_t, int>> edges;
+    {
+        std::mt19937_64 rng(0);
+        auto txn = graph.begin_transaction();
+        for (vertex_t i = 0; i < num_vertices; i++)
+            txn.new_vertex();
+        for (size_t i = 0; i < num_edges; i++)
+        {
+            vertex_t u = rng() % num_vertices, v = rng() % num_vertices;
+            int version = rng() % 100;
+            txn.put_edge_with_version(u, 0, v, "", version, true);
+            txn.put_edge_with_version(v, 1, u, "", version, true);
+            edges.emplace(u, v, version);
+        }
+        txn.commit();
+    }
+    auto has_edge = [&](vertex_t u, vertex_t v, int start, int end) {
+        for (int version = start; version <= end; version++)
+            if (edges.count({u, v, version}))
+                return true;
+        return false;
+    };
+    auto txn = graph.begin_read_only_transaction();
+
+    SUBCASE("directed triangle")
+    {
+        size_t expected = 0, expected_window = 0;
+        for (vertex_t a = 0; a < num_vertices; a++)
+            for (vertex_t b = 0; b < num_vertices; b++)
+                for (vertex_t c = 0; c < num_vertices; c++)
+                {
+                    if (a == b || b == c || a == c)
+                        continue;
+                    expected += has_edge(a, b, 0, 99) && has_edge(b, c, 0, 99) && has_edge(c, a, 0, 99);
+                    expected_window += has_edge(a, b, 20, 80) && has_edge(b, c, 20, 80) && has_edge(c, a, 20, 80);
+                }
+        REQUIRE(expected > 0);
+
+        Pattern triangle(3);
+        triangle.add_edge(0, 1, 0).add_edge(1, 2, 0).add_edge(2, 0, 0);
+        CHECK(txn.count_pattern(triangle, 16) == expected);
+
+        std::mutex mutex;
+        std::set<std::tuple<vertex_t, vertex_t, vertex_t>> matches;
+        txn.match_pattern(triangle, [&](const vertex_t *binding) {
+            CHECK((has_edge(binding[0], binding[1], 0, 99) && has_edge(binding[1], binding[2], 0, 99) &&
+                   has_edge(binding[2], binding[0], 0, 99)));
+            std::lock_guard<std::mutex> lock(mutex);
+            matches.emplace(binding[0], binding[1], binding[2]);
+        });
+        CHECK(matches.size() == expected);
+
+        Pattern window(3);
+        window.add_edge(0, 1, 0, 20, 80).add_edge(1, 2, 0, 20, 80).add_edge(2, 0, 0, 20, 80);
+        CHECK(txn.count_pattern(window) == expected_window);
+    }
+
+    SUBCASE("reverse labels and homomorphisms")
+    {
+        // 0 -> 2 <- 1: 1 is only reachable through the reversed edges
+        Pattern in_star(3);
+        in_star.add_edge(0, 2, 0);
+        CHECK_THROWS_AS(in_star.plan(), std::invalid_argument);
+
+        Pattern reversed(3);
+        reversed.add_edge(0, 2, 0).add_edge(PatternEdge{1, 2, 0, false, 0, 0, 1});
+        std::vector<std::set<vertex_t>> in_neighbors(num_vertices);
+        for (auto [u, v, version] : edges)
+            in_neighbors[v].insert(u);
+        size_t expected = 0;
+        for (vertex_t v = 0; v < num_vertices; v++)
+        {
+            size_t n = in_neighbors[v].size() - in_neighbors[v].count(v);
+            expected += n * (n - 1);
+        }
+        CHECK(txn.count_pattern(reversed) == expected);
+
+        // Without injectivity both pattern vertices may bind to the same source
+        Pattern homomorphism(3, false);
+        homomorphism.add_edge(0, 2, 0).add_edge(PatternEdge{1, 2, 0, false, 0, 0, 1});
+        size_t expected_homomorphisms = 0;
+        for (vertex_t v = 0; v < num_vertices; v++)
+            expected_homomorphisms += in_neighbors[v].size() * in_neighbors[v].size();
+        CHECK(txn.count_pattern(homomorphism) == expected_homomorphisms);
+
+        Pattern self_loop(1);
+        self_loop.add_edge(0, 0, 0);
+        size_t expected_loops = 0;
+        for (vertex_t v = 0; v < num_vertices; v++)
+            expected_loops += in_neighbors[v].count(v);
+        CHECK(txn.count_pattern(self_loop) == expected_loops);
+    }
+}
+
+TEST_CASE("testing the Transaction: interleaved BFS")
+{
+    Graph graph;
+    const vertex_t num_vertices = 500;
+    {
+        auto txn = graph.begin_transaction();
+        for (vertex_t i = 0; i < num_vertices; i++)
+            txn.new_vertex();
+        txn.commit();
+    }
+    std::mt19937_64 rng(0);
+    std::uniform_int_distribution<vertex_t> uniform(0, num_vertices - 1);
+    // Several commits, so that adjacency lists grow over more than one edge block
+    for (size_t round = 0; round < 4; round++)
+    {
+        auto txn = graph.begin_transaction();
+        for (size_t i = 0; i < num_vertices / 2; i++)
+            txn.put_edge(uniform(rng), 0, uniform(rng), "");
+        txn.put_edge(round, 1, round + 1, "");
+        txn.commit();
+    }
+    {
+        auto txn = graph.begin_transaction();
+        for (vertex_t i = 0; i < num_vertices; i += 3)
+            txn.del_edge(uniform(rng), 0, uniform(rng));
+        txn.commit();
+    }
+    auto reader = graph.begin_read_only_transaction();
+    // Uncommitted edges are only visible to the writer
+    auto writer = graph.begin_transaction();
+    for (vertex_t i = 0; i < 10; i++)
+        writer.put_edge(num_vertices - 1, 0, i, "");
+    writer.put_edge(4, 1, 5, "");
+
+    auto expected_bfs = [&](Transaction &txn, vertex_t root, label_t label) {
+        std::vector<uint32_t> distances(num_vertices, Transaction::NOT_REACHED);
+        std::vector<vertex_t> queue{root};
+        distances[root] = 0;
+        for (size_t i = 0; i < queue.size(); i++)
+        {
+            for (auto iter = txn.get_edges(queue[i], label); iter.valid(); iter.next())
+            {
+                if (distances[iter.dst_id()] == Transaction::NOT_REACHED)
+                {
+                    distances[iter.dst_id()] = distances[queue[i]] + 1;
+                    queue.push_back(iter.dst_id());
+                }
+            }
+        }
+        return distances;
+    };
+
+    for (size_t group_size : {1ul, 4ul, Transaction::INTERLEAVE_GROUP_SIZE, 1000ul})
+    {
+        for (vertex_t root : {0ul, 7ul, num_vertices - 1})
+        {
+            CHECK(reader.bfs(root, 0, group_size) == expected_bfs(reader, root, 0));
+            CHECK(writer.bfs(root, 0, group_size) == expected_bfs(writer, root, 0));
+        }
+        auto chain = reader.bfs(0, 1, group_size);
+        CHECK(chain[4] == 4);
+        CHECK(chain[5] == Transaction::NOT_REACHED);
+        CHECK(writer.bfs(0, 1, group_size)[5] == 5);
+        CHECK(reader.bfs(0, 2, group_size)[1] == Transaction::NOT_REACHED);
+    }
+    CHECK(reader.bfs(num_vertices - 1, 0) != writer.bfs(num_vertices - 1, 0));
+    CHECK_THROWS_AS(reader.bfs(num_vertices, 0), std::invalid_argument);
+    writer.abort();
+}
+
+TEST_CASE("testing the Transaction: get_edges_batch")
+{
+    Graph graph;
+    const vertex_t num_vertices = 300;
+    {
+        auto txn = graph.begin_transaction();
+        for (vertex_t i = 0; i < num_vertices; i++)
+            txn.new_vertex();
+        txn.commit();
+    }
+    std::mt19937_64 rng(0);
+    for (size_t round = 0; round < 3; round++)
+    {
+        auto txn = graph.begin_transaction();
+        for (size_t i = 0; i < num_vertices * 2; i++)
+            txn.put_edge_with_version(rng() % num_vertices, 0, rng() % num_vertices, std::to_string(i),
+                                      rng() % 100, true);
+        txn.commit();
+    }
+    auto reader = graph.begin_read_only_transaction();
+    auto writer = graph.begin_transaction();
+    for (vertex_t i = 0; i < 10; i++)
+        writer.put_edge_with_version(i, 0, num_vertices - 1, "new", 50, true);
+
+    std::vector<vertex_t> srcs;
+    for (vertex_t i = 0; i < num_vertices; i++)
+        srcs.push_back(rng() % num_vertices);
+    srcs.push_back(num_vertices + 1);
+
+    using Edges = std::vector<std::pair<vertex_t, std::string>>;
+    auto drain = [](auto iter) {
+        Edges edges;
+        for (; iter.valid(); iter.next())
+            edges.emplace_back(iter.dst_id(), std::string(iter.edge_data()));
+        return edges;
+    };
+    for (auto *txn : {&reader, &writer})
+    {
+        for (size_t group_size : {1ul, 7ul, Transaction::INTERLEAVE_GROUP_SIZE})
+        {
+            auto iters = txn->get_edges_batch(srcs.data(), srcs.size(), 0, group_size);
+            auto window_iters = txn->get_edges_batch(srcs.data(), srcs.size(), 0, 20, 60, group_size);
+            REQUIRE(iters.size() == srcs.size());
+            REQUIRE(window_iters.size() == srcs.size());
+            for (size_t i = 0; i < srcs.size(); i++)
+            {
+                CHECK(drain(iters[i]) == drain(txn->get_edges(srcs[i], 0)));
+                CHECK(drain(window_iters[i]) == drain(txn->get_edges_with_version(srcs[i], 0, 20, 60)));
+            }
+        }
+        CHECK(txn->get_edges_batch(srcs.data(), 0, 0).empty());
+    }
+    const vertex_t written = 3;
+    CHECK(drain(writer.get_edges_batch(&written, 1, 0)[0]) != drain(reader.get_edges_batch(&written, 1, 0)[0]));
+    writer.abort();
+}
+
+TEST_CASE("testing the Transaction: external keys")
+{
+    GraphOptions options;
+    options.max_keys = 1000;
+    Graph graph("", "", 1ul << 30, 1ul << 20, options);
+
+    auto early_reader = graph.begin_read_only_transaction();
+    auto early_writer = graph.begin_transaction();
+    auto txn = graph.begin_transaction();
+    auto [a, created] = txn.find_or_create_vertex("alice");
+    CHECK(created);
+    CHECK(txn.find_or_create_vertex("alice") == std::make_pair(a, false));
+    CHECK(txn.find_vertex("alice") == a);
+    CHECK(txn.get_vertex_key(a) == "alice");
+    txn.put_vertex(a, "data");
+
+    // Uncommitted: invisible to a snapshot, a conflict for a writer
+    CHECK(early_reader.find_vertex("alice") == Transaction::NO_VERTEX);
+    CHECK(early_reader.get_vertex_key(a) == "");
+    {
+        auto writer = graph.begin_transaction();
+        CHECK_THROWS_AS(writer.find_or_create_vertex("alice"), Transaction::RollbackExcept);
+        writer.abort();
+    }
+    txn.commit();
+
+    {
+        auto reader = graph.begin_read_only_transaction();
+        CHECK(reader.find_vertex("alice") == a);
+        CHECK(reader.get_vertex_key(a) == "alice");
+        CHECK(reader.get_vertex(a) == "data");
+    }
+    CHECK(early_reader.find_vertex("alice") == Transaction::NO_VERTEX);
+    // Committed after its read epoch
+    CHECK_THROWS_AS(early_writer.find_or_create_vertex("alice"), Transaction::RollbackExcept);
+    early_writer.abort();
+
+    // An aborted insertion leaves the key free
+    {
+        auto aborted = graph.begin_transaction();
+        CHECK(aborted.find_or_create_vertex("bob").second);
+        aborted.abort();
+    }
+    vertex_t b;
+    {
+        auto writer = graph.begin_transaction();
+        CHECK(writer.find_vertex("bob") == Transaction::NO_VERTEX);
+        bool b_created;
+        std::tie(b, b_created) = writer.find_or_create_vertex("bob", true);
+        CHECK(b_created);
+        CHECK(writer.get_vertex_key(b) == "bob");
+        writer.commit();
+    }
+    {
+        auto writer = graph.begin_transaction();
+        CHECK(writer.find_vertex("bob") == b);
+        CHECK(writer.find_or_create_vertex("bob") == std::make_pair(b, false));
+        CHECK(writer.find_vertex(std::string("bob\0", 4)) == Transaction::NO_VERTEX);
+        CHECK(writer.find_vertex("") == Transaction::NO_VERTEX);
+        writer.abort();
+    }
+
+    SUBCASE("concurrent batch loading")
+    {
+        const size_t num_keys = 800, num_threads = 4;
+        std::vector<std::vector<vertex_t>> ids(num_threads, std::vector<vertex_t>(num_keys));
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < num_threads; t++)
+        {
+            threads.emplace_back([&, t]() {
+                auto loader = graph.begin_batch_loader();
+                // Every thread creates the same keys, in a different order
+                for (size_t i = 0; i < num_keys; i++)
+                {
+                    auto key = (i + t * num_keys / num_threads) % num_keys;
+                    ids[t][key] = loader.find_or_create_vertex("key" + std::to_string(key)).first;
+                }
+                loader.commit();
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+
+        auto reader = graph.begin_read_only_transaction();
+        std::set<vertex_t> distinct;
+        for (size_t key = 0; key < num_keys; key++)
+        {
+            for (size_t t = 1; t < num_threads; t++)
+                CHECK(ids[t][key] == ids[0][key]);
+            CHECK(reader.find_vertex("key" + std::to_string(key)) == ids[0][key]);
+            CHECK(reader.get_vertex_key(ids[0][key]) == "key" + std::to_string(key));
+            distinct.insert(ids[0][key]);
+        }
+        CHECK(distinct.size() == num_keys);
+        CHECK(reader.find_vertex("alice") == a);
+
+        auto loader = graph.begin_batch_loader();
+        CHECK_THROWS_AS(
+            [&]() {
+                for (size_t i = 0;; i++)
+                    loader.find_or_create_vertex("overflow" + std::to_string(i));
+            }(),
+            std::runtime_error);
+        loader.commit();
+    }
+
+    SUBCASE("rolled back keys and a full table")
+    {
+        // Room for 8 slots
+        options.max_keys = 4;
+        Graph small("", "", 1ul << 30, 1ul << 20, options);
+        // Retrying a rolled back insertion reuses its slot
+        for (size_t i = 0; i < 100; i++)
+        {
+            auto txn = small.begin_transaction();
+            CHECK(txn.find_or_create_vertex("retried").second);
+            txn.abort();
+        }
+        {
+            auto txn = small.begin_transaction();
+            auto [vertex, created] = txn.find_or_create_vertex("retried");
+            CHECK(created);
+            txn.commit();
+            CHECK(small.begin_read_only_transaction().find_vertex("retried") == vertex);
+        }
+        // Slots of rolled back keys are reused by other keys, and their blocks freed by compaction
+        for (size_t i = 0; i < 100; i++)
+        {
+            auto txn = small.begin_transaction();
+            CHECK(txn.find_or_create_vertex("dead" + std::to_string(i)).second);
+            txn.abort();
+        }
+        small.compact();
+        {
+            auto txn = small.begin_transaction();
+            for (size_t i = 0; i < 7; i++)
+                CHECK(txn.find_or_create_vertex("live" + std::to_string(i)).second);
+            CHECK(txn.find_vertex("dead0") == Transaction::NO_VERTEX);
+            txn.commit();
+        }
+        {
+            auto reader = small.begin_read_only_transaction();
+            CHECK(reader.find_vertex("retried") != Transaction::NO_VERTEX);
+            for (size_t i = 0; i < 7; i++)
+                CHECK(reader.find_vertex("live" + std::to_string(i)) != Transaction::NO_VERTEX);
+        }
+
+        Graph full("", "", 1ul << 30, 1ul << 20, options);
+        auto loader = full.begin_batch_loader();
+        for (size_t i = 0; i < 8; i++)
+            loader.find_or_create_vertex("key" + std::to_string(i));
+        auto next = loader.new_vertex();
+        loader.del_vertex(next, true);
+        // The id taken for the key that does not fit is recycled, and its block freed
+        CHECK_THROWS_AS(loader.find_or_create_vertex("overflow"), std::runtime_error);
+        std::set<vertex_t> recycled{loader.new_vertex(true), loader.new_vertex(true)};
+        CHECK(recycled.size() == 2);
+        CHECK(recycled.count(next));
+        CHECK(loader.new_vertex(true) == next + 2);
+        loader.commit();
+    }
+
+    SUBCASE("recovery from the block region")
+    {
+        early_reader.abort();
+        vertex_t c;
+        {
+            auto loader = graph.begin_batch_loader();
+            c = loader.find_or_create_vertex("carol").first;
+            loader.commit();
+        }
+        {
+            auto aborted = graph.begin_transaction();
+            CHECK(aborted.find_or_create_vertex("dave").second);
+            aborted.abort();
+        }
+        // As after a restart: only the blocks are left
+        graph.recover_key_index();
+        auto reader = graph.begin_read_only_transaction();
+        CHECK(reader.find_vertex("alice") == a);
+        CHECK(reader.find_vertex("bob") == b);
+        CHECK(reader.find_vertex("carol") == c);
+        CHECK(reader.find_vertex("dave") == Transaction::NO_VERTEX);
+        CHECK(reader.get_vertex_key(a) == "alice");
+        CHECK(reader.get_vertex_key(c) == "carol");
+        reader.abort();
+        auto writer = graph.begin_transaction();
+        CHECK(writer.find_or_create_vertex("alice") == std::make_pair(a, false));
+        CHECK(writer.find_or_create_vertex("dave").second);
+        writer.commit();
+    }
+
+    SUBCASE("disabled")
+    {
+        Graph plain;
+        CHECK_THROWS_AS(plain.recover_key_index(), std::invalid_argument);
+        auto txn = plain.begin_transaction();
+        CHECK_THROWS_AS(txn.find_or_create_vertex("alice"), std::invalid_argument);
+        CHECK_THROWS_AS(txn.find_vertex("alice"), std::invalid_argument);
+        txn.abort();
+    }
+}
+
+TEST_CASE("testing the Transaction: vertex indexes")
+{
+    // Vertex data: a one-byte flag followed by a double score
+    auto make_data = [](char flag, double score) {
+        std::string data(1 + sizeof(score), flag);
+        std::memcpy(data.data() + 1, &score, sizeof(score));
+        return data;
+    };
+    auto flag_of = [](std::string_view data, std::string &key) {
+        if (data.empty() || data[0] == '-')
+            return false;
+        key.assign(data.substr(0, 1));
+        return true;
+    };
+    auto score_of = [](std::string_view data, std::string &key) {
+        double score;
+        std::memcpy(&score, data.data() + 1, sizeof(score));
+        key = VertexIndex::encode(score);
+        return true;
+    };
+
+    Graph graph;
+    const vertex_t num_vertices = 300;
+    std::vector<std::string> expected(num_vertices);
+    std::mt19937_64 rng(0);
+    {
+        auto loader = graph.begin_batch_loader();
+        for (vertex_t v = 0; v < num_vertices / 2; v++)
+        {
+            loader.new_vertex();
+            expected[v] = make_data("abc"[rng() % 3], (double)(rng() % 2000) / 100 - 10);
+            loader.put_vertex(v, expected[v]);
+        }
+        loader.commit();
+    }
+    // Filled from the existing vertices, then maintained
+    auto flags = graph.create_vertex_index(VertexIndex::Type::Hash, flag_of);
+    auto scores = graph.create_vertex_index(VertexIndex::Type::Ordered, score_of);
+    {
+        auto loader = graph.begin_batch_loader();
+        for (vertex_t v = num_vertices / 2; v < num_vertices; v++)
+        {
+            loader.new_vertex();
+            expected[v] = make_data("abc-"[rng() % 4], (double)(rng() % 2000) / 100 - 10);
+            loader.put_vertex(v, expected[v]);
+        }
+        loader.commit();
+    }
+
+    auto check = [&](Transaction &txn, const std::vector<std::string> &expected) {
+        for (char flag : {'a', 'b', 'c', '-', 'z'})
+        {
+            std::set<vertex_t> result, reference;
+            for (auto v : txn.find_vertices(flags, std::string(1, flag)))
+                CHECK(result.insert(v).second);
+            for (vertex_t v = 0; v < num_vertices; v++)
+                if (!expected[v].empty() && expected[v][0] == flag && flag != '-')
+                    reference.insert(v);
+            CHECK(result == reference);
+        }
+        for (auto [low, high] : {std::pair<double, double>{-10, 10}, {-2.5, 3}, {0, 0}, {5.5, 5.5}, {20, 30}})
+        {
+            std::vector<std::pair<double, vertex_t>> reference;
+            for (vertex_t v = 0; v < num_vertices; v++)
+            {
+                if (expected[v].empty())
+                    continue;
+                double score;
+                std::memcpy(&score, expected[v].data() + 1, sizeof(score));
+                if (score >= low && score <= high)
+                    reference.emplace_back(score, v);
+            }
+            // In key order; equal keys in no particular order
+            auto result = txn.find_vertices(scores, VertexIndex::encode(low), VertexIndex::encode(high));
+            std::sort(reference.begin(), reference.end());
+            REQUIRE(result.size() == reference.size());
+            std::multiset<vertex_t> result_set(result.begin(), result.end()), reference_set;
+            for (size_t i = 0; i < reference.size(); i++)
+            {
+                double score;
+                std::memcpy(&score, expected[result[i]].data() + 1, sizeof(score));
+                CHECK(score == reference[i].first);
+                reference_set.insert(reference[i].second);
+            }
+            CHECK(result_set == reference_set);
+        }
+    };
+
+    auto before = expected;
+    auto old_reader = graph.begin_read_only_transaction();
+    check(old_reader, before);
+
+    auto txn = graph.begin_transaction();
+    for (vertex_t v = 0; v < num_vertices; v += 3)
+    {
+        expected[v] = make_data("abc-"[rng() % 4], (double)(rng() % 2000) / 100 - 10);
+        txn.put_vertex(v, expected[v]);
+    }
+    for (vertex_t v = 1; v < num_vertices; v += 7)
+    {
+        txn.del_vertex(v);
+        expected[v].clear();
+    }
+    // Changed twice, and back to its original value
+    txn.put_vertex(2, make_data('z', 100));
+    txn.put_vertex(2, before[2]);
+    check(txn, expected);
+    check(old_reader, before);
+    txn.commit();
+
+    auto committed = expected;
+    auto reader = graph.begin_read_only_transaction();
+    check(reader, committed);
+    check(old_reader, before);
+
+    {
+        auto aborted = graph.begin_transaction();
+        for (vertex_t v = 0; v < num_vertices; v += 2)
+            aborted.put_vertex(v, make_data('c', 1));
+        aborted.del_vertex(5);
+        aborted.abort();
+    }
+    {
+        auto txn = graph.begin_transaction();
+        check(txn, expected);
+        expected[4] = make_data('a', -3);
+        txn.put_vertex(4, expected[4]);
+        txn.commit();
+    }
+    auto last_reader = graph.begin_read_only_transaction();
+    check(last_reader, expected);
+    check(reader, committed);
+
+    CHECK(VertexIndex::encode(-1.5) < VertexIndex::encode(-0.5));
+    CHECK(VertexIndex::encode(-0.5) < VertexIndex::encode(0.0));
+    CHECK(VertexIndex::encode(int64_t(-1)) < VertexIndex::encode(int64_t(1)));
+    CHECK(VertexIndex::encode(uint32_t(255)) < VertexIndex::encode(uint32_t(256)));
+    CHECK_THROWS_AS(reader.find_vertices(flags, "a", "b"), std::invalid_argument);
+    CHECK_THROWS_AS(reader.find_vertices(2, "a"), std::invalid_argument);
+}
+
+TEST_CASE("testing the Transaction: version index")
+{
+    Graph graph;
+    const vertex_t num_vertices = 200;
+    std::mt19937_64 rng(0);
+    auto put_edges = [&](Transaction &txn, size_t num_edges) {
+        for (size_t i = 0; i < num_edges; i++)
+            txn.put_edge_with_version(rng() % num_vertices, rng() % 2, rng() % num_vertices,
+                                      std::to_string(rng() % 1000), rng() % 5000, rng() % 2);
+    };
+    {
+        auto loader = graph.begin_batch_loader();
+        for (vertex_t v = 0; v < num_vertices; v++)
+            loader.new_vertex();
+        put_edges(loader, 2000);
+        loader.commit();
+    }
+    CHECK_THROWS_AS(graph.begin_read_only_transaction().get_edges_by_version(0, 0, 100), std::invalid_argument);
+    // Filled from the existing edges, then maintained
+    graph.create_version_index(6);
+    {
+        auto loader = graph.begin_batch_loader();
+        put_edges(loader, 1000);
+        loader.commit();
+    }
+
+    using Edge = std::tuple<timestamp_t, vertex_t, vertex_t, std::string>;
+    auto brute_force = [&](Transaction &txn, label_t label, timestamp_t start, timestamp_t end) {
+        std::multiset<Edge> edges;
+        for (vertex_t v = 0; v < num_vertices; v++)
+            for (auto iter = txn.get_edges(v, label); iter.valid(); iter.next())
+                if (iter.version() >= start && iter.version() <= end)
+                    edges.emplace(iter.version(), v, iter.dst_id(), std::string(iter.edge_data()));
+        return edges;
+    };
+    auto check = [&](Transaction &txn) {
+        for (auto [start, end] : {std::pair<timestamp_t, timestamp_t>{0, 5000}, {100, 163}, {1000, 1000}, {64, 127},
+                                  {4990, 10000}, {300, 200}})
+        {
+            for (label_t label : {0, 1})
+            {
+                auto edges = txn.get_edges_by_version(label, start, end);
+                std::multiset<Edge> result;
+                for (size_t i = 0; i < edges.size(); i++)
+                {
+                    CHECK(edges[i].label == label);
+                    if (i > 0)
+                        CHECK(edges[i - 1].version <= edges[i].version);
+                    result.emplace(edges[i].version, edges[i].src, edges[i].dst, edges[i].data);
+                }
+                CHECK(result == brute_force(txn, label, start, end));
+            }
+        }
+    };
+
+    for (size_t round = 0; round < 3; round++)
+    {
+        auto txn = graph.begin_transaction();
+        put_edges(txn, 500);
+        txn.commit();
+    }
+    auto reader = graph.begin_read_only_transaction();
+    check(reader);
+    {
+        auto aborted = graph.begin_transaction();
+        put_edges(aborted, 500);
+        check(aborted);
+        aborted.abort();
+    }
+    auto writer = graph.begin_transaction();
+    put_edges(writer, 500);
+    writer.put_edge(0, 0, 1, "unversioned");
+    check(writer);
+    check(reader);
+    // Unlike get_edges_with_version, which counts the entries committed in place after the read epoch
+    auto before = reader.get_edges_by_version(0, 0, 5000);
+    writer.commit();
+    auto after = reader.get_edges_by_version(0, 0, 5000);
+    CHECK(std::equal(before.begin(), before.end(), after.begin(), after.end(), [](const auto &a, const auto &b) {
+        return std::tie(a.version, a.src, a.dst, a.data) == std::tie(b.version, b.src, b.dst, b.data);
+    }));
+    auto new_reader = graph.begin_read_only_transaction();
+    check(new_reader);
+    CHECK(new_reader.get_edges_by_version(0, 0, 5000).size() > reader.get_edges_by_version(0, 0, 5000).size());
+
+    // Deleted edges leave later snapshots but stay in older ones
+    auto edges = new_reader.get_edges_by_version(1, 0, 5000);
+    REQUIRE(!edges.empty());
+    {
+        auto deleter = graph.begin_transaction();
+        for (size_t i = 0; i < edges.size(); i += 2)
+            deleter.del_edge(edges[i].src, 1, edges[i].dst);
+        check(deleter);
+        deleter.commit();
+    }
+    check(new_reader);
+    CHECK(new_reader.get_edges_by_version(1, 0, 5000).size() == edges.size());
+    {
+        auto txn = graph.begin_read_only_transaction();
+        check(txn);
+        CHECK(txn.get_edges_by_version(1, 0, 5000).size() < edges.size());
+    }
+
+    // Compaction drops the index entries of edges deleted before every reader
+    reader.abort();
+    new_reader.abort();
+    graph.compact();
+    graph.compact();
+    {
+        auto txn = graph.begin_read_only_transaction();
+        check(txn);
+    }
+
+    CHECK_THROWS_AS(graph.create_version_index(), std::runtime_error);
+}
+
+TEST_CASE("testing the Transaction: edge changes")
+{
+    Graph graph;
+    const vertex_t num_vertices = 100;
+    {
+        auto txn = graph.begin_transaction();
+        for (vertex_t v = 0; v < num_vertices; v++)
+            txn.new_vertex();
+        txn.commit();
+    }
+    CHECK_THROWS_AS(graph.begin_read_only_transaction().get_edge_changes(0, 0, 0), std::invalid_argument);
+    graph.enable_edge_change_log();
+
+    std::mt19937_64 rng(0);
+    auto update = [&](Transaction &txn, size_t num_ops) {
+        for (size_t i = 0; i < num_ops; i++)
+        {
+            vertex_t src = rng() % num_vertices, dst = rng() % 20;
+            label_t label = rng() % 2;
+            if (rng() % 4 == 0)
+                txn.del_edge(src, label, dst);
+            else
+                txn.put_edge(src, label, dst, std::to_string(rng() % 1000));
+        }
+    };
+
+    using Edge = std::tuple<vertex_t, vertex_t, std::string>;
+    auto snapshot = [&](Transaction &txn, label_t label) {
+        std::multiset<Edge> edges;
+        for (vertex_t v = 0; v < num_vertices; v++)
+            for (auto iter = txn.get_edges(v, label); iter.valid(); iter.next())
+                edges.emplace(v, iter.dst_id(), std::string(iter.edge_data()));
+        return edges;
+    };
+    auto difference = [](const std::multiset<Edge> &a, const std::multiset<Edge> &b) {
+        std::multiset<Edge> result;
+        std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::inserter(result, result.end()));
+        return result;
+    };
+
+    // Snapshots at every epoch; without compaction they keep the deleted edges
+    std::vector<Transaction> readers;
+    readers.emplace_back(graph.begin_read_only_transaction());
+    for (size_t round = 0; round < 6; round++)
+    {
+        {
+            auto txn = graph.begin_transaction();
+            update(txn, 200);
+            if (round == 2)
+                txn.abort();
+            else
+                txn.commit();
+        }
+        if (round == 3)
+        {
+            auto loader = graph.begin_batch_loader();
+            update(loader, 100);
+            loader.commit();
+        }
+        readers.emplace_back(graph.begin_read_only_transaction());
+    }
+
+    auto &latest = readers.back();
+    for (size_t i = 0; i < readers.size(); i += 2)
+    {
+        for (size_t j = i; j < readers.size(); j += 3)
+        {
+            auto e1 = readers[i].get_read_epoch_id(), e2 = readers[j].get_read_epoch_id();
+            for (label_t label : {0, 1})
+            {
+                auto before = snapshot(readers[i], label), after = snapshot(readers[j], label);
+                auto inserted = difference(after, before), deleted = difference(before, after);
+
+                auto changes = latest.get_edge_changes(label, e1, e2);
+                std::multiset<Edge> result_inserted, result_deleted;
+                for (const auto &change : changes)
+                {
+                    CHECK(change.epoch > e1);
+                    CHECK(change.epoch <= e2);
+                    (change.inserted ? result_inserted : result_deleted)
+                        .emplace(change.src, change.dst, std::string(change.data));
+                }
+                CHECK(result_inserted == inserted);
+                CHECK(result_deleted == deleted);
+
+                // The log only narrows down the sources
+                size_t num_changes = 0;
+                for (vertex_t v = 0; v < num_vertices; v++)
+                    num_changes += latest.get_edge_changes(v, label, e1, e2).size();
+                CHECK(num_changes == changes.size());
+            }
+        }
+    }
+
+    auto e = latest.get_read_epoch_id();
+    CHECK(latest.get_edge_changes(0, e, e).empty());
+    CHECK(latest.get_edge_changes(num_vertices + 1, 0, 0, e).empty());
+    CHECK_THROWS_AS(readers[0].get_edge_changes(0, 0, e), std::invalid_argument);
+    CHECK_THROWS_AS(latest.get_edge_changes(0, e, e - 1), std::invalid_argument);
+    CHECK_THROWS_AS(latest.get_edge_changes(0, 0, e), std::invalid_argument);
+}